@@ -8,11 +8,69 @@
 #ifndef PT_CONFIG_H
 #define PT_CONFIG_H
 
+#include <memory>
+
 namespace pt
 {
 
+class LstmPrefixCache;
+
 class Config
 {
+
+public:
+    // LSTM states cache shared by sequences with common prefixes (disabled by default):
+    const std::shared_ptr<LstmPrefixCache>& getLstmPrefixCache() const noexcept
+    {
+        return _lstmPrefixCache;
+    }
+
+    void setLstmPrefixCache(std::shared_ptr<LstmPrefixCache> lstmPrefixCache) noexcept
+    {
+        _lstmPrefixCache = std::move(lstmPrefixCache);
+    }
+
+    // Winograd algorithm for eligible 3x3 Conv2D layers (enabled by default):
+    bool getConv2DWinograd() const noexcept
+    {
+        return _conv2DWinograd;
+    }
+
+    void setConv2DWinograd(bool conv2DWinograd) noexcept
+    {
+        _conv2DWinograd = conv2DWinograd;
+    }
+
+    // Fusion of layer sequences loaded from a model file, like Conv2D followed by MaxPooling2D (enabled by default).
+    // Fused layers run the original layers one by one if it is disabled:
+    bool getLayerFusion() const noexcept
+    {
+        return _layerFusion;
+    }
+
+    void setLayerFusion(bool layerFusion) noexcept
+    {
+        _layerFusion = layerFusion;
+    }
+
+    // Output tile rows and columns of depth-first tiled execution (disabled by default, zero).
+    // Sequences of convolutional, pooling and activation layers are applied tile by tile if enabled,
+    // so intermediate tensors are not stored in full size:
+    std::size_t getTileSize() const noexcept
+    {
+        return _tileSize;
+    }
+
+    void setTileSize(std::size_t tileSize) noexcept
+    {
+        _tileSize = tileSize;
+    }
+
+protected:
+    std::shared_ptr<LstmPrefixCache> _lstmPrefixCache;
+    std::size_t _tileSize = 0;
+    bool _conv2DWinograd = true;
+    bool _layerFusion = true;
 };
 
 }
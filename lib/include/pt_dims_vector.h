@@ -0,0 +1,190 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_DIMS_VECTOR_H
+#define PT_DIMS_VECTOR_H
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include <initializer_list>
+#include "pt_assert.h"
+
+namespace pt
+{
+
+// Tensor dims, stored inline so tensors can be created, copied and reshaped without heap allocations:
+class DimsVector
+{
+
+public:
+    static constexpr std::size_t MaxSize = 4;
+
+    using value_type = std::size_t;
+    using iterator = std::size_t*;
+    using const_iterator = const std::size_t*;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    DimsVector() noexcept :
+        _dims(),
+        _size(0)
+    {
+    }
+
+    DimsVector(std::initializer_list<std::size_t> dims) noexcept :
+        _dims(),
+        _size(dims.size())
+    {
+        PT_ASSERT(_size <= MaxSize);
+
+        std::copy(dims.begin(), dims.end(), _dims.begin());
+    }
+
+    template<class Iterator>
+    DimsVector(Iterator first, Iterator last) noexcept :
+        _dims(),
+        _size(0)
+    {
+        assign(first, last);
+    }
+
+    std::size_t size() const noexcept
+    {
+        return _size;
+    }
+
+    bool empty() const noexcept
+    {
+        return _size == 0;
+    }
+
+    const std::size_t* data() const noexcept
+    {
+        return _dims.data();
+    }
+
+    std::size_t* data() noexcept
+    {
+        return _dims.data();
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return _dims.data();
+    }
+
+    iterator begin() noexcept
+    {
+        return _dims.data();
+    }
+
+    const_iterator end() const noexcept
+    {
+        return _dims.data() + _size;
+    }
+
+    iterator end() noexcept
+    {
+        return _dims.data() + _size;
+    }
+
+    const_reverse_iterator rbegin() const noexcept
+    {
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator rend() const noexcept
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    std::size_t operator[](std::size_t index) const noexcept
+    {
+        PT_ASSERT(index < _size);
+
+        return _dims[index];
+    }
+
+    std::size_t& operator[](std::size_t index) noexcept
+    {
+        PT_ASSERT(index < _size);
+
+        return _dims[index];
+    }
+
+    std::size_t front() const noexcept
+    {
+        return (*this)[0];
+    }
+
+    std::size_t back() const noexcept
+    {
+        return (*this)[_size - 1];
+    }
+
+    void clear() noexcept
+    {
+        _size = 0;
+    }
+
+    void push_back(std::size_t dim) noexcept
+    {
+        PT_ASSERT(_size < MaxSize);
+
+        _dims[_size] = dim;
+        ++_size;
+    }
+
+    iterator insert(const_iterator position, std::size_t dim) noexcept
+    {
+        PT_ASSERT(_size < MaxSize);
+
+        auto it = begin() + (position - begin());
+        std::copy_backward(it, end(), end() + 1);
+        *it = dim;
+        ++_size;
+        return it;
+    }
+
+    iterator erase(const_iterator position) noexcept
+    {
+        auto it = begin() + (position - begin());
+        std::copy(it + 1, end(), it);
+        --_size;
+        return it;
+    }
+
+    template<class Iterator>
+    void assign(Iterator first, Iterator last) noexcept
+    {
+        _size = 0;
+
+        for(; first != last; ++first)
+        {
+            push_back(std::size_t(*first));
+        }
+    }
+
+    friend bool operator==(const DimsVector& a, const DimsVector& b) noexcept
+    {
+        return a._size == b._size && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    friend bool operator!=(const DimsVector& a, const DimsVector& b) noexcept
+    {
+        return ! (a == b);
+    }
+
+private:
+    std::array<std::size_t, MaxSize> _dims;
+    std::size_t _size;
+};
+
+}
+
+#endif
@@ -8,7 +8,10 @@
 #ifndef PT_LAYER_DATA_H
 #define PT_LAYER_DATA_H
 
+#include <vector>
+#include <cstdint>
 #include "pt_tensor.h"
+#include "pt_token_vector.h"
 
 namespace pt
 {
@@ -22,6 +25,9 @@ struct LayerData
     Tensor& out;
     Dispatcher& dispatcher;
     const Config& config;
+    std::vector<Tensor>* state;
+    std::vector<std::uint8_t> mask;
+    TokenVector tokens;
 };
 
 }
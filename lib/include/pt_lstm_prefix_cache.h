@@ -0,0 +1,103 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_LSTM_PREFIX_CACHE_H
+#define PT_LSTM_PREFIX_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "pt_tensor.h"
+
+namespace pt
+{
+
+// Bounded LRU cache of LSTM states, checkpointed every interval steps of the input sequences.
+// Sequences which share a prefix resume the recurrence from the longest checkpointed prefix.
+class LstmPrefixCache
+{
+
+public:
+    LstmPrefixCache(std::size_t maxBytes, std::size_t interval);
+
+    std::size_t getMaxBytes() const noexcept
+    {
+        return _maxBytes;
+    }
+
+    std::size_t getInterval() const noexcept
+    {
+        return _interval;
+    }
+
+    std::size_t getBytes() const;
+
+    std::size_t getEntriesCount() const;
+
+    std::size_t getHits() const;
+
+    std::size_t getMisses() const;
+
+    std::size_t getSkippedSteps() const;
+
+    void clear();
+
+protected:
+    friend class LstmLayer;
+
+    // Prefixes are identified by two independent hashes, so a hit needs both of them to collide:
+    struct Key
+    {
+        std::uint64_t layerId;
+        std::uint64_t hash;
+        std::uint64_t checkHash;
+        std::size_t steps;
+
+        bool operator==(const Key& other) const noexcept
+        {
+            return layerId == other.layerId && hash == other.hash && checkHash == other.checkHash &&
+                    steps == other.steps;
+        }
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const noexcept;
+    };
+
+    struct Entry
+    {
+        Key key;
+        std::vector<Tensor::Type> data;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    mutable std::mutex _mutex;
+    EntryList _entries;
+    std::unordered_map<Key, EntryList::iterator, KeyHash> _entriesMap;
+    std::size_t _maxBytes;
+    std::size_t _interval;
+    std::size_t _bytes;
+    std::size_t _hits;
+    std::size_t _misses;
+    std::size_t _skippedSteps;
+
+    static std::size_t _entryBytes(std::size_t size) noexcept;
+
+    bool _get(const Key& key, Tensor::Type* data, std::size_t size);
+
+    void _put(const Key& key, const Tensor::Type* data, std::size_t size);
+
+    void _registerLookup(std::size_t skippedSteps);
+};
+
+}
+
+#endif
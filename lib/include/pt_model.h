@@ -10,14 +10,18 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include "pt_layer.h"
 #include "pt_config.h"
+#include "pt_token_vector.h"
 
 namespace pt
 {
 
 class Tensor;
 class Dispatcher;
+class RnnState;
+struct LayerData;
 
 class Model
 {
@@ -31,6 +35,19 @@ public:
 
     bool predict(Dispatcher& dispatcher, Tensor in, Tensor& out) const;
 
+    bool step(RnnState& state, Tensor in, Tensor& out) const;
+
+    bool step(Dispatcher& dispatcher, RnnState& state, Tensor in, Tensor& out) const;
+
+    // Integer token ids for models starting with an Embedding layer:
+    bool predict(TokenVector in, Tensor& out) const;
+
+    bool predict(Dispatcher& dispatcher, TokenVector in, Tensor& out) const;
+
+    bool step(RnnState& state, TokenVector in, Tensor& out) const;
+
+    bool step(Dispatcher& dispatcher, RnnState& state, TokenVector in, Tensor& out) const;
+
     const Config& getConfig() const noexcept
     {
         return _config;
@@ -49,8 +66,18 @@ public:
 protected:
     std::vector<std::unique_ptr<Layer>> _layers;
     Config _config;
+    std::uint64_t _id;
 
     Model(std::vector<std::unique_ptr<Layer>>&& layers) noexcept;
+
+    // Binds an unused state to this model, or checks that it belongs to it:
+    bool _bindState(RnnState& state) const;
+
+    bool _apply(Dispatcher& dispatcher, RnnState* state, Tensor in, Tensor& out) const;
+
+    bool _apply(Dispatcher& dispatcher, RnnState* state, TokenVector in, Tensor& out) const;
+
+    bool _apply(RnnState* state, LayerData& layerData) const;
 };
 
 }
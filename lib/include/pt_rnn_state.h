@@ -0,0 +1,56 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_RNN_STATE_H
+#define PT_RNN_STATE_H
+
+#include <vector>
+#include <cstdint>
+#include "pt_tensor.h"
+
+namespace pt
+{
+
+class Model;
+
+// Recurrent and causal convolution state carried across Model::step calls (one tensors list per layer).
+// It is bound to the model of its first step call until it is reset:
+class RnnState
+{
+
+public:
+    RnnState() = default;
+
+    bool isEmpty() const noexcept
+    {
+        for(const auto& layerState : _layerStates)
+        {
+            if(! layerState.empty())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void reset() noexcept
+    {
+        _layerStates.clear();
+        _modelId = 0;
+    }
+
+protected:
+    friend class Model;
+
+    std::vector<std::vector<Tensor>> _layerStates;
+    std::uint64_t _modelId = 0;
+};
+
+}
+
+#endif
@@ -13,6 +13,7 @@
 #include <iosfwd>
 #include "pt_libsimdpp.h"
 #include "pt_assert.h"
+#include "pt_dims_vector.h"
 
 namespace pt
 {
@@ -28,7 +29,7 @@ public:
     static constexpr auto VectorSize = FloatSize;
     static constexpr auto Alignment = sizeof(Type) * VectorSize;
 
-    using DimsVector = std::vector<std::size_t>;
+    using DimsVector = pt::DimsVector;
     using DataVector = std::vector<Type, simdpp::aligned_allocator<Type, Alignment>>;
 
     static std::unique_ptr<Tensor> create(std::size_t dims, std::istream& stream);
@@ -65,7 +66,10 @@ public:
         return _dims;
     }
 
-    std::size_t getSize() const noexcept;
+    std::size_t getSize() const noexcept
+    {
+        return _data.size();
+    }
 
     const DataVector& getData() const noexcept
     {
@@ -191,6 +195,8 @@ public:
         return output;
     }
 
+    // Elementwise operations. Operands dims must be the same as the last dims of this tensor,
+    // and they are repeated for each of the leading indices (NumPy broadcasting):
     void add(const Tensor& other, Tensor& out, Dispatcher& dispatcher) const;
 
     Tensor add(const Tensor& other, Dispatcher& dispatcher) const
@@ -0,0 +1,22 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_TOKEN_VECTOR_H
+#define PT_TOKEN_VECTOR_H
+
+#include <vector>
+#include <cstdint>
+
+namespace pt
+{
+
+// Embedding input ids. Unlike tensor values, ids above 2^24 are represented exactly:
+using TokenVector = std::vector<std::uint32_t>;
+
+}
+
+#endif
@@ -21,6 +21,15 @@
     #define PT_LOOP_UNROLLING_ENABLE 0
 #endif
 
+// Define min Conv2D input and output channels to use the implicit GEMM path:
+#define PT_CONV_2D_GEMM_MIN_CHANNELS 64
+
+// Define max Conv1D input channels to use the output filters vectorized path:
+#define PT_CONV_1D_FILTERS_MAX_CHANNELS 32
+
+// Define max size in bytes of the LSTM input projections table precomputed for Embedding -> LSTM sequences:
+#define PT_EMBEDDING_LSTM_MAX_TABLE_SIZE (64 * 1024 * 1024)
+
 // Define max CPU threads:
 #define PT_MAX_CPU_THREADS 16
 
@@ -109,4 +109,20 @@ bool ActivationLayer::apply(LayerData& layerData) const
     return true;
 }
 
+bool ActivationLayer::getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const
+{
+    outDims = inDims;
+    return true;
+}
+
+SpatialLayer::Region ActivationLayer::getInputRegion(const Tensor::DimsVector&, const Region& outRegion) const noexcept
+{
+    return outRegion;
+}
+
+bool ActivationLayer::applyTile(LayerData& layerData, const Tensor::DimsVector&, const Region&, const Region&) const
+{
+    return apply(layerData);
+}
+
 }
@@ -8,14 +8,12 @@
 #ifndef PT_ACTIVATION_LAYER_H
 #define PT_ACTIVATION_LAYER_H
 
-#include "pt_layer.h"
+#include "pt_spatial_layer.h"
 
 namespace pt
 {
 
-class Tensor;
-
-class ActivationLayer : public Layer
+class ActivationLayer : public SpatialLayer
 {
 
 public:
@@ -25,6 +23,13 @@ public:
 
     bool apply(LayerData& layerData) const final;
 
+    bool getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const final;
+
+    Region getInputRegion(const Tensor::DimsVector& inDims, const Region& outRegion) const noexcept final;
+
+    bool applyTile(LayerData& layerData, const Tensor::DimsVector& inDims, const Region& inRegion,
+                   const Region& outRegion) const final;
+
 protected:
     ActivationLayer() = default;
 };
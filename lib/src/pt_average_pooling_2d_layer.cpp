@@ -0,0 +1,104 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_average_pooling_2d_layer.h"
+
+#include <array>
+#include <algorithm>
+#include "pt_dispatcher.h"
+#include "pt_layer_data.h"
+#include "pt_output_tiles.h"
+#include "pt_pooling.h"
+
+namespace pt
+{
+
+std::unique_ptr<AveragePooling2DLayer> AveragePooling2DLayer::create(std::istream& stream)
+{
+    Params params;
+
+    if(! _parse(stream, params))
+    {
+        return nullptr;
+    }
+
+    return std::unique_ptr<AveragePooling2DLayer>(new AveragePooling2DLayer(params));
+}
+
+void AveragePooling2DLayer::_apply(LayerData& layerData, const Geometry& geometry) const
+{
+    struct Task
+    {
+        const AveragePooling2DLayer* layer;
+        const Geometry* geometry;
+        const OutputTiles* tiles;
+        LayerData* layerData;
+        int taskId;
+
+        void operator()() noexcept
+        {
+            const Tensor& in = layerData->in;
+            Tensor& out = layerData->out;
+
+            const auto& iw = in.getDims();
+            auto rows = int(iw[0]);
+            auto cols = int(iw[1]);
+            auto channels = int(iw[2]);
+            auto inIncY = cols * channels;
+            auto outIncY = geometry->outX * channels;
+
+            auto inBegin = in.getData().data();
+            auto outBegin = const_cast<Tensor::Type*>(out.getData().data());
+
+            for(int index = tiles->taskBegin(taskId), end = tiles->taskEnd(taskId); index != end; ++index)
+            {
+                OutputTiles::Tile tile = tiles->tile(index);
+                auto size = tile.channelEnd - tile.channelBegin;
+
+                // Window rows and columns outside of the input are padding, so they are skipped:
+                int iy = tile.row * layer->_strideY - geometry->padTop;
+                int yBegin = std::max(iy, 0);
+                int yEnd = std::min(iy + layer->_poolSizeY, rows);
+
+                for(int x = tile.colBegin; x != tile.colEnd; ++x)
+                {
+                    int ix = x * layer->_strideX - geometry->padLeft;
+                    int xBegin = std::max(ix, 0);
+                    int xEnd = std::min(ix + layer->_poolSizeX, cols);
+                    PoolWindow window{ yEnd - yBegin, xEnd - xBegin, inIncY, channels };
+
+                    auto inPixel = inBegin + yBegin * inIncY + xBegin * channels + tile.channelBegin;
+                    auto outPixel = outBegin + tile.row * outIncY + x * channels + tile.channelBegin;
+                    poolChannels<AveragePooling>(inPixel, window, outPixel, size);
+                }
+            }
+        }
+    };
+
+    const auto& iw = layerData.in.getDims();
+    auto channels = int(iw[2]);
+    Tensor& out = layerData.out;
+    out.resize(std::size_t(geometry.outY), std::size_t(geometry.outX), iw[2]);
+
+    // Channel blocks are only split if the overlapped last vectors don't cross them:
+    std::array<Task, PT_MAX_CPU_THREADS> tasks;
+    Dispatcher& dispatcher = layerData.dispatcher;
+    auto threads = int(dispatcher.threads());
+    int channelStep = channels % Tensor::VectorSize == 0 ? int(Tensor::VectorSize) : channels;
+    OutputTiles tiles{ geometry.outY, geometry.outX, channels, 1, channelStep, threads };
+
+    for(int taskId = 0; taskId != threads; ++taskId)
+    {
+        Task& task = tasks[std::size_t(taskId)];
+        task = Task{ this, &geometry, &tiles, &layerData, taskId };
+        dispatcher.add([&task]{ task(); });
+    }
+
+    dispatcher.join();
+}
+
+}
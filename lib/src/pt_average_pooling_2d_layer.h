@@ -0,0 +1,35 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_AVERAGE_POOLING_2D_LAYER_H
+#define PT_AVERAGE_POOLING_2D_LAYER_H
+
+#include "pt_pooling_2d_layer.h"
+
+namespace pt
+{
+
+class AveragePooling2DLayer : public Pooling2DLayer
+{
+
+public:
+    static std::unique_ptr<AveragePooling2DLayer> create(std::istream& stream);
+
+protected:
+    friend class Conv2DAveragePooling2DLayer;
+
+    explicit AveragePooling2DLayer(const Params& params) noexcept :
+        Pooling2DLayer(params)
+    {
+    }
+
+    void _apply(LayerData& layerData, const Geometry& geometry) const final;
+};
+
+}
+
+#endif
@@ -45,9 +45,10 @@ bool BatchNormalizationLayer::apply(LayerData& layerData) const
 {
     const Tensor& in = layerData.in;
 
-    if(in.getDims() != _weights.getDims())
+    // Weights and biases are applied per channel (last input dim):
+    if(! in.isValid() || in.getDims().back() != _weights.getSize())
     {
-        PT_LOG_ERROR << "Input and weights tensor dims are different" <<
+        PT_LOG_ERROR << "Input tensor last dim must be the same as weights size" <<
                             " (input dims: " << VectorPrinter<std::size_t>{ in.getDims() } << ")" <<
                             " (weights dims: " << VectorPrinter<std::size_t>{ _weights.getDims() } << ")" << std::endl;
         return false;
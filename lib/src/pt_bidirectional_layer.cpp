@@ -0,0 +1,257 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_bidirectional_layer.h"
+
+#include "pt_parser.h"
+#include "pt_dispatcher.h"
+#include "pt_layer_data.h"
+#include "pt_logger.h"
+
+namespace pt
+{
+
+std::unique_ptr<BidirectionalLayer> BidirectionalLayer::create(std::istream& stream)
+{
+    unsigned int mergeMode = 0;
+
+    if(! Parser::parse(stream, mergeMode))
+    {
+        PT_LOG_ERROR << "Merge mode parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(mergeMode < Concat || mergeMode > Ave)
+    {
+        PT_LOG_ERROR << "Invalid merge mode: " << mergeMode << std::endl;
+        return nullptr;
+    }
+
+    auto forward = LstmLayer::create(stream);
+
+    if(! forward)
+    {
+        PT_LOG_ERROR << "Forward LSTM layer parse failed" << std::endl;
+        return nullptr;
+    }
+
+    auto backward = LstmLayer::create(stream);
+
+    if(! backward)
+    {
+        PT_LOG_ERROR << "Backward LSTM layer parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(forward->_w.getDims() != backward->_w.getDims())
+    {
+        PT_LOG_ERROR << "Forward and backward w tensor dims must be the same" <<
+                            " (forward w dims: " << VectorPrinter<std::size_t>{ forward->_w.getDims() } << ")" <<
+                            " (backward w dims: " << VectorPrinter<std::size_t>{ backward->_w.getDims() } << ")" <<
+                            std::endl;
+        return nullptr;
+    }
+
+    if(forward->_returnSequences != backward->_returnSequences)
+    {
+        PT_LOG_ERROR << "Forward and backward return sequences must be the same" << std::endl;
+        return nullptr;
+    }
+
+    return std::unique_ptr<BidirectionalLayer>(new BidirectionalLayer(std::move(forward), std::move(backward),
+                                                                      MergeMode(mergeMode)));
+}
+
+bool BidirectionalLayer::apply(LayerData& layerData) const
+{
+    Tensor& in = layerData.in;
+
+    if(in.getDims().size() == 1)
+    {
+        // Single step:
+        in.resize(1, in.getDims()[0]);
+    }
+
+    const auto& iw = in.getDims();
+
+    if(iw.size() != 2)
+    {
+        PT_LOG_ERROR << "Input tensor dims count must be 1 or 2" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
+        return false;
+    }
+
+    const auto& ww = _forward->_w.getDims();
+
+    if(iw[1] != ww[1])
+    {
+        PT_LOG_ERROR << "Input tensor dims[1] must be the same as w dims[1]" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                            " (w dims: " << VectorPrinter<std::size_t>{ ww } << ")" << std::endl;
+        return false;
+    }
+
+    if(layerData.state)
+    {
+        PT_LOG_ERROR << "Bidirectional layers can't be applied step by step" << std::endl;
+        return false;
+    }
+
+    auto steps = iw[0];
+    const std::uint8_t* mask = nullptr;
+
+    if(! layerData.mask.empty())
+    {
+        if(layerData.mask.size() != steps)
+        {
+            PT_LOG_ERROR << "Mask size must be the same as input tensor dims[0]" <<
+                                " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                                " (mask size: " << layerData.mask.size() << ")" << std::endl;
+            return false;
+        }
+
+        mask = layerData.mask.data();
+    }
+
+    auto forwardData = _forward->_tempDataPool.acquire(_forward->_units);
+    auto backwardData = _backward->_tempDataPool.acquire(_backward->_units);
+
+    for(LstmLayer::TempData* tempData : { forwardData.get(), backwardData.get() })
+    {
+        tempData->ht.fill(0);
+        tempData->ct.fill(0);
+    }
+
+    const std::uint8_t* reversedMask = nullptr;
+
+    if(mask)
+    {
+        backwardData->reversedMask.assign(layerData.mask.rbegin(), layerData.mask.rend());
+        reversedMask = backwardData->reversedMask.data();
+    }
+
+    // Both directions project the input in sequence order, the backward layer reads its projections from the last:
+    Dispatcher& dispatcher = layerData.dispatcher;
+    _forward->_project(in, mask, 0, *forwardData, dispatcher);
+    _backward->_project(in, mask, 0, *backwardData, dispatcher);
+
+    auto units = _forward->_units;
+    auto xwInc = std::ptrdiff_t(units * 4);
+    const Tensor& backwardXw = backwardData->xw;
+    const Tensor::Type* backwardXwPtr = backwardXw.getData().data();
+
+    if(backwardXw.getSize())
+    {
+        backwardXwPtr += backwardXw.getSize() - units * 4;
+    }
+
+    // Each direction writes its own half of the concatenated output:
+    Tensor& out = layerData.out;
+    auto returnSequences = _forward->_returnSequences;
+    Tensor::Type* forwardOutPtr = nullptr;
+    Tensor::Type* backwardOutPtr = nullptr;
+    auto outInc = std::ptrdiff_t(units * 2);
+
+    if(returnSequences)
+    {
+        out.resize(steps, units * 2);
+        forwardOutPtr = &*out.begin();
+        backwardOutPtr = forwardOutPtr + (steps - 1) * units * 2 + units;
+    }
+
+    // Recurrences can't be parallelized, but both directions can run at the same time:
+    dispatcher.add([&]
+    {
+        _forward->_runSteps(forwardData->xw.getData().data(), xwInc, steps, mask, *forwardData, forwardOutPtr,
+                            outInc);
+    });
+
+    dispatcher.add([&]
+    {
+        _backward->_runSteps(backwardXwPtr, -xwInc, steps, reversedMask, *backwardData, backwardOutPtr,
+                             -outInc);
+    });
+
+    dispatcher.join();
+
+    if(! returnSequences)
+    {
+        out.resize(units * 2);
+        std::copy(forwardData->ht.begin(), forwardData->ht.end(), out.begin());
+        std::copy(backwardData->ht.begin(), backwardData->ht.end(), out.begin() + long(units));
+        layerData.mask.clear();
+    }
+
+    _forward->_tempDataPool.release(std::move(forwardData));
+    _backward->_tempDataPool.release(std::move(backwardData));
+
+    if(_mergeMode != Concat)
+    {
+        // Halves are merged in place:
+        auto outSteps = out.getSize() / (units * 2);
+        auto outIt = out.begin();
+
+        for(std::size_t step = 0; step != outSteps; ++step)
+        {
+            auto forwardIt = out.begin() + long(step * units * 2);
+            auto backwardIt = forwardIt + long(units);
+
+            for(std::size_t index = 0; index != units; ++index)
+            {
+                Tensor::Type forwardValue = forwardIt[long(index)];
+                Tensor::Type backwardValue = backwardIt[long(index)];
+
+                switch(_mergeMode)
+                {
+
+                case Sum:
+                    *outIt = forwardValue + backwardValue;
+                    break;
+
+                case Mul:
+                    *outIt = forwardValue * backwardValue;
+                    break;
+
+                case Ave:
+                    *outIt = (forwardValue + backwardValue) / 2;
+                    break;
+
+                case Concat:
+                    break;
+                }
+
+                ++outIt;
+            }
+        }
+
+        if(returnSequences)
+        {
+            out.resize(steps, units);
+        }
+        else
+        {
+            out.resize(units);
+        }
+    }
+
+    if(returnSequences)
+    {
+        out.eraseDummyDims();
+    }
+
+    return true;
+}
+
+BidirectionalLayer::BidirectionalLayer(std::unique_ptr<LstmLayer>&& forward, std::unique_ptr<LstmLayer>&& backward,
+                                       MergeMode mergeMode) noexcept :
+    _forward(std::move(forward)),
+    _backward(std::move(backward)),
+    _mergeMode(mergeMode)
+{
+}
+
+}
@@ -0,0 +1,43 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_BIDIRECTIONAL_LAYER_H
+#define PT_BIDIRECTIONAL_LAYER_H
+
+#include "pt_lstm_layer.h"
+
+namespace pt
+{
+
+class BidirectionalLayer : public Layer
+{
+
+public:
+    static std::unique_ptr<BidirectionalLayer> create(std::istream& stream);
+
+    bool apply(LayerData& layerData) const final;
+
+protected:
+    enum MergeMode
+    {
+        Concat = 1,
+        Sum = 2,
+        Mul = 3,
+        Ave = 4
+    };
+
+    std::unique_ptr<LstmLayer> _forward;
+    std::unique_ptr<LstmLayer> _backward;
+    MergeMode _mergeMode;
+
+    BidirectionalLayer(std::unique_ptr<LstmLayer>&& forward, std::unique_ptr<LstmLayer>&& backward,
+                       MergeMode mergeMode) noexcept;
+};
+
+}
+
+#endif
@@ -8,9 +8,13 @@
 #include "pt_conv_1d_layer.h"
 
 #include <array>
+#include <utility>
+#include <algorithm>
+#include "pt_parser.h"
 #include "pt_dispatcher.h"
 #include "pt_layer_data.h"
 #include "pt_multiply_add.h"
+#include "pt_output_tiles.h"
 #include "pt_logger.h"
 
 namespace pt
@@ -18,15 +22,24 @@ namespace pt
 
 namespace
 {
+    struct Conv1DParams
+    {
+        int stride;
+        int dilation;
+        int padLeft;
+    };
+
     template<class MultiplyAddType>
-    void multiplyAddImpl(const Tensor& weights, const Tensor& biases, LayerData& layerData)
+    void multiplyAddImpl(const Tensor& weights, const Tensor& biases, const Conv1DParams& params,
+                         LayerData& layerData)
     {
         struct Task
         {
             const Tensor* weights;
             const Tensor* biases;
+            const Conv1DParams* params;
+            const OutputTiles* tiles;
             LayerData* layerData;
-            int threads;
             int taskId;
 
             void operator()() noexcept
@@ -34,46 +47,229 @@ namespace
                 const Tensor& in = layerData->in;
                 Tensor& out = layerData->out;
 
+                const auto& iw = in.getDims();
                 const auto& ww = weights->getDims();
-                const auto& ow = out.getDims();
-                auto outInc = int(ow[1]);
-                auto wInc = int(ww[2] * ww[1]);
-                auto wInc2 = int(ww[2]);
-
-                auto tx = int(ow[0]);
-
-                auto inBegin = in.begin();
-                auto outBegin = out.begin();
-                auto wBegin = weights->begin();
-                auto wEnd = weights->end();
-                auto bBegin = biases->begin();
+                auto outInc = int(ww[0]);
+                auto wInc = int(ww[1] * ww[2]);
+                auto kernelSize = int(ww[1]);
+                auto channels = int(ww[2]);
+                auto steps = int(iw[0]);
+
+                auto stride = params->stride;
+                auto dilation = params->dilation;
+
+                auto inBegin = in.getData().data();
+                auto outBegin = const_cast<Tensor::Type*>(out.getData().data());
+                auto wBegin = weights->getData().data();
+                auto bBegin = biases->getData().data();
                 MultiplyAddType multiplyAdd;
 
-                int its = tx;
-                int taskIts = its / threads;
-                int taskBegin = taskIts * taskId;
-                int taskEnd;
+                for(int index = tiles->taskBegin(taskId), end = tiles->taskEnd(taskId); index != end; ++index)
+                {
+                    OutputTiles::Tile tile = tiles->tile(index);
+
+                    for(int x = tile.colBegin; x != tile.colEnd; ++x)
+                    {
+                        // Kernel steps outside of the input are zero padding, so they are skipped:
+                        int ix = x * stride - params->padLeft;
+                        int kBegin = ix < 0 ? (dilation - 1 - ix) / dilation : 0;
+                        int kEnd = std::max(std::min(kernelSize, (steps - ix + dilation - 1) / dilation), kBegin);
+                        auto outIt = outBegin + x * outInc;
+
+                        for(int filter = tile.channelBegin; filter != tile.channelEnd; ++filter)
+                        {
+                            auto wIt = wBegin + filter * wInc;
+                            auto value = bBegin[filter];
+
+                            if(dilation == 1)
+                            {
+                                // Valid kernel steps are contiguous in the input:
+                                value += multiplyAdd(inBegin + (ix + kBegin) * channels, wIt + kBegin * channels,
+                                                     (kEnd - kBegin) * channels);
+                            }
+                            else
+                            {
+                                for(int k = kBegin; k != kEnd; ++k)
+                                {
+                                    value += multiplyAdd(inBegin + (ix + k * dilation) * channels,
+                                                         wIt + k * channels, channels);
+                                }
+                            }
+
+                            outIt[filter] = value;
+                        }
+                    }
+                }
+            }
+        };
+
+        std::array<Task, PT_MAX_CPU_THREADS> tasks;
+        Dispatcher& dispatcher = layerData.dispatcher;
+        auto threads = int(dispatcher.threads());
+        const auto& ow = layerData.out.getDims();
+        OutputTiles tiles{ 1, int(ow[0]), int(ow[1]), 1, 1, threads };
+
+        for(int taskId = 0; taskId != threads; ++taskId)
+        {
+            Task& task = tasks[std::size_t(taskId)];
+            task = Task{ &weights, &biases, &params, &tiles, &layerData, taskId };
+            dispatcher.add([&task]{ task(); });
+        }
+
+        dispatcher.join();
+    }
 
-                if(taskId == threads - 1)
+    constexpr int filtersTileSteps = 4;
+
+    struct FiltersTileParams
+    {
+        int filters;
+        int filterBegin;
+        int filterEnd;
+        int channels;
+        int kBegin;
+        int kEnd;
+        int inInc;
+    };
+
+    // A tile of output steps times a block of output filters is accumulated in registers, reading a broadcast
+    // input value and a vector of packed weights for each kernel step and input channel:
+    template<int Steps, int Vectors>
+    PT_INLINE void filtersTile(const Tensor::Type* inBegin, const int* inOffsets, const Tensor::Type* wBegin,
+                               const Tensor::Type* bBegin, Tensor::Type* outBegin,
+                               const FiltersTileParams& params) noexcept
+    {
+        auto filters = params.filters;
+        auto channels = params.channels;
+
+        for(int filter = params.filterBegin; filter != params.filterEnd; filter += Tensor::VectorSize * Vectors)
+        {
+            Tensor::Vector acc[Steps][Vectors];
+
+            for(int vector = 0; vector != Vectors; ++vector)
+            {
+                Tensor::Vector bias = simdpp::load(bBegin + filter + vector * Tensor::VectorSize);
+
+                for(int step = 0; step != Steps; ++step)
                 {
-                    taskEnd = its;
+                    acc[step][vector] = bias;
+                }
+            }
+
+            for(int k = params.kBegin; k != params.kEnd; ++k)
+            {
+                auto inOffset = k * params.inInc;
+                auto wIt = wBegin + k * channels * filters + filter;
+
+                for(int channel = 0; channel != channels; ++channel)
+                {
+                    Tensor::Vector w[Vectors];
+
+                    for(int vector = 0; vector != Vectors; ++vector)
+                    {
+                        w[vector] = simdpp::load(wIt + vector * Tensor::VectorSize);
+                    }
+
+                    for(int step = 0; step != Steps; ++step)
+                    {
+                        Tensor::Vector value = simdpp::splat(inBegin[inOffsets[step] + inOffset + channel]);
+
+                        for(int vector = 0; vector != Vectors; ++vector)
+                        {
+                            acc[step][vector] = detail::madd(value, w[vector], acc[step][vector]);
+                        }
+                    }
+
+                    wIt += filters;
                 }
-                else
+            }
+
+            for(int step = 0; step != Steps; ++step)
+            {
+                for(int vector = 0; vector != Vectors; ++vector)
                 {
-                    taskEnd = taskBegin + taskIts;
+                    simdpp::store(outBegin + step * filters + filter + vector * Tensor::VectorSize,
+                                  acc[step][vector]);
                 }
+            }
+        }
+    }
+
+    // Output filters are vectorized, so layers with few input channels don't waste vector lanes:
+    template<int Vectors>
+    void filtersImpl(const Tensor& weights, const Tensor& biases, const Conv1DParams& params, LayerData& layerData)
+    {
+        struct Task
+        {
+            const Tensor* weights;
+            const Tensor* biases;
+            const Conv1DParams* params;
+            const OutputTiles* tiles;
+            LayerData* layerData;
+            int taskId;
+
+            void operator()() noexcept
+            {
+                const Tensor& in = layerData->in;
+                Tensor& out = layerData->out;
+
+                const auto& iw = in.getDims();
+                const auto& ww = weights->getDims();
+                auto kernelSize = int(ww[0]);
+                auto channels = int(ww[1]);
+                auto filters = int(ww[2]);
+                auto steps = int(iw[0]);
 
-                for(int x = taskBegin; x != taskEnd; ++x)
+                auto stride = params->stride;
+                auto dilation = params->dilation;
+                auto padLeft = params->padLeft;
+
+                FiltersTileParams tileParams{ filters, 0, 0, channels, 0, 0, dilation * channels };
+
+                auto inBegin = in.getData().data();
+                auto outBegin = const_cast<Tensor::Type*>(out.getData().data());
+                auto wBegin = weights->getData().data();
+                auto bBegin = biases->getData().data();
+
+                // Output steps whose kernel steps are all inside the input:
+                int xInteriorBegin = (padLeft + stride - 1) / stride;
+                int xInteriorEnd = std::max(steps - 1 - (kernelSize - 1) * dilation + padLeft, -1) / stride + 1;
+                int inOffsets[filtersTileSteps];
+
+                for(int index = tiles->taskBegin(taskId), end = tiles->taskEnd(taskId); index != end; ++index)
                 {
-                    auto inIt = inBegin + x * wInc2;
-                    auto outIt = outBegin + x * outInc;
-                    auto bIt = bBegin;
+                    OutputTiles::Tile tile = tiles->tile(index);
+                    tileParams.filterBegin = tile.channelBegin;
+                    tileParams.filterEnd = tile.channelEnd;
 
-                    for(auto wIt = wBegin; wIt != wEnd; wIt += wInc)
+                    for(int x = tile.colBegin; x != tile.colEnd; )
                     {
-                        *outIt = *bIt + multiplyAdd(&*inIt, &*wIt, wInc);
-                        ++outIt;
-                        ++bIt;
+                        int ix = x * stride - padLeft;
+                        auto outIt = outBegin + x * filters;
+
+                        if(x >= xInteriorBegin && x + filtersTileSteps <= std::min(xInteriorEnd, tile.colEnd))
+                        {
+                            for(int step = 0; step != filtersTileSteps; ++step)
+                            {
+                                inOffsets[step] = (ix + step * stride) * channels;
+                            }
+
+                            tileParams.kBegin = 0;
+                            tileParams.kEnd = kernelSize;
+                            filtersTile<filtersTileSteps, Vectors>(inBegin, inOffsets, wBegin, bBegin, outIt,
+                                                                   tileParams);
+                            x += filtersTileSteps;
+                        }
+                        else
+                        {
+                            // Border steps skip padded kernel steps:
+                            inOffsets[0] = ix * channels;
+                            tileParams.kBegin = ix < 0 ? (dilation - 1 - ix) / dilation : 0;
+                            tileParams.kEnd = std::max(std::min(kernelSize, (steps - ix + dilation - 1) / dilation),
+                                                       tileParams.kBegin);
+                            filtersTile<1, Vectors>(inBegin, inOffsets, wBegin, bBegin, outIt, tileParams);
+                            ++x;
+                        }
                     }
                 }
             }
@@ -82,16 +278,43 @@ namespace
         std::array<Task, PT_MAX_CPU_THREADS> tasks;
         Dispatcher& dispatcher = layerData.dispatcher;
         auto threads = int(dispatcher.threads());
+        const auto& ow = layerData.out.getDims();
+        OutputTiles tiles{ 1, int(ow[0]), int(ow[1]), filtersTileSteps, Tensor::VectorSize * Vectors, threads };
 
         for(int taskId = 0; taskId != threads; ++taskId)
         {
             Task& task = tasks[std::size_t(taskId)];
-            task = Task{ &weights, &biases, &layerData, threads, taskId };
+            task = Task{ &weights, &biases, &params, &tiles, &layerData, taskId };
             dispatcher.add([&task]{ task(); });
         }
 
         dispatcher.join();
     }
+
+    Tensor packFiltersWeights(const Tensor& weights)
+    {
+        // (outputs, steps, depth) to (steps, depth, outputs):
+        const auto& ww = weights.getDims();
+        auto filters = ww[0];
+        auto kernelSize = ww[1];
+        auto channels = ww[2];
+        Tensor packed(kernelSize, channels, filters);
+        auto wIt = weights.begin();
+
+        for(std::size_t filter = 0; filter != filters; ++filter)
+        {
+            for(std::size_t k = 0; k != kernelSize; ++k)
+            {
+                for(std::size_t channel = 0; channel != channels; ++channel)
+                {
+                    packed(k, channel, filter) = *wIt;
+                    ++wIt;
+                }
+            }
+        }
+
+        return packed;
+    }
 }
 
 std::unique_ptr<Conv1DLayer> Conv1DLayer::create(std::istream& stream)
@@ -120,23 +343,84 @@ std::unique_ptr<Conv1DLayer> Conv1DLayer::create(std::istream& stream)
         return nullptr;
     }
 
-    return std::unique_ptr<Conv1DLayer>(new Conv1DLayer(std::move(*weights), std::move(*biases),
-                                                        std::move(activation)));
+    unsigned int stride = 0;
+
+    if(! Parser::parse(stream, stride))
+    {
+        PT_LOG_ERROR << "Stride parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(stride == 0)
+    {
+        PT_LOG_ERROR << "Invalid stride: " << stride << std::endl;
+        return nullptr;
+    }
+
+    unsigned int padding = 0;
+
+    if(! Parser::parse(stream, padding))
+    {
+        PT_LOG_ERROR << "Padding parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(padding != Valid && padding != Same && padding != Causal)
+    {
+        PT_LOG_ERROR << "Invalid padding: " << padding << std::endl;
+        return nullptr;
+    }
+
+    unsigned int dilation = 0;
+
+    if(! Parser::parse(stream, dilation))
+    {
+        PT_LOG_ERROR << "Dilation rate parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(dilation == 0)
+    {
+        PT_LOG_ERROR << "Invalid dilation rate: " << dilation << std::endl;
+        return nullptr;
+    }
+
+    // Layers with few input channels vectorize output filters instead of kernel windows:
+    auto weightsDims = weights->getDims();
+    auto filters = weightsDims[0];
+    auto channels = weightsDims[2];
+    bool filtersPath = filters % Tensor::VectorSize == 0 && channels < PT_CONV_1D_FILTERS_MAX_CHANNELS;
+
+    if(filtersPath)
+    {
+        *weights = packFiltersWeights(*weights);
+    }
+
+    return std::unique_ptr<Conv1DLayer>(new Conv1DLayer(std::move(weightsDims), std::move(*weights),
+                                                        std::move(*biases), std::move(activation), stride,
+                                                        dilation, Padding(padding), filtersPath));
 }
 
 bool Conv1DLayer::apply(LayerData& layerData) const
 {
-    const Tensor& in = layerData.in;
+    Tensor& in = layerData.in;
+
+    if(in.getDims().size() == 1)
+    {
+        // Single step:
+        in.resize(1, in.getDims()[0]);
+    }
+
     const auto& iw = in.getDims();
 
     if(iw.size() != 2)
     {
-        PT_LOG_ERROR << "Input tensor dims count must be 2" <<
+        PT_LOG_ERROR << "Input tensor dims count must be 1 or 2" <<
                             " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
         return false;
     }
 
-    const auto& ww = _weights.getDims();
+    const auto& ww = _weightsDims;
 
     if(iw[1] != ww[2])
     {
@@ -146,35 +430,164 @@ bool Conv1DLayer::apply(LayerData& layerData) const
         return false;
     }
 
-    auto offset = ww[1] - 1;
-    Tensor& out = layerData.out;
-    out.resize(iw[0] - offset, ww[0]);
+    // Streamed causal layers only compute the output steps of the new input steps.
+    // Other layers would convolve each chunk in isolation, unless they have no history (kernel size 1, stride 1):
+    if(layerData.state && _stride == 1 && ww[1] > 1)
+    {
+        if(_padding != Causal)
+        {
+            PT_LOG_ERROR << "Only causal Conv1D layers can be applied step by step" <<
+                                " (padding: " << _padding << ")" << std::endl;
+            return false;
+        }
 
-    auto threads = int(layerData.dispatcher.threads());
-    auto threadSize = int(ww[2] * ww[1]) / threads;
+        return _step(layerData);
+    }
 
-    if(PT_LOOP_UNROLLING_ENABLE && threadSize && threadSize % (Tensor::VectorSize * 2) == 0)
+    if(layerData.state && _stride != 1)
     {
-        multiplyAddImpl<Vector2MultiplyAdd>(_weights, _biases, layerData);
+        PT_LOG_ERROR << "Conv1D layers with stride greater than 1 can't be applied step by step" <<
+                            " (stride: " << _stride << ")" << std::endl;
+        return false;
     }
-    else if(threadSize && threadSize % Tensor::VectorSize == 0)
+
+    // Dilated kernel size:
+    auto kernelSize = (ww[1] - 1) * _dilation + 1;
+    int padLeft = 0;
+    std::size_t outSize;
+
+    switch(_padding)
+    {
+
+    case Valid:
+        if(iw[0] < kernelSize)
+        {
+            PT_LOG_ERROR << "Input tensor is smaller than the kernel" <<
+                                " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                                " (weights dims: " << VectorPrinter<std::size_t>{ ww } << ")" << std::endl;
+            return false;
+        }
+
+        outSize = (iw[0] - kernelSize) / _stride + 1;
+        break;
+
+    case Same:
     {
-        multiplyAddImpl<VectorMultiplyAdd>(_weights, _biases, layerData);
+        // Same as TensorFlow, extra padding goes to the right side:
+        outSize = (iw[0] + _stride - 1) / _stride;
+
+        auto pad = (outSize - 1) * _stride + kernelSize;
+        padLeft = pad > iw[0] ? int(pad - iw[0]) / 2 : 0;
+        break;
+    }
+
+    case Causal:
+        // Outputs only depend on current and past steps:
+        outSize = (iw[0] + _stride - 1) / _stride;
+        padLeft = int(kernelSize - 1);
+        break;
+
+    default:
+        PT_LOG_ERROR << "Invalid padding: " << _padding << std::endl;
+        return false;
+    }
+
+    _apply(layerData, padLeft, outSize);
+    return true;
+}
+
+bool Conv1DLayer::_step(LayerData& layerData) const
+{
+    const Tensor& in = layerData.in;
+    const auto& iw = in.getDims();
+    const auto& ww = _weightsDims;
+
+    // The state holds a window buffer which starts with the last inputs seen by the dilated kernel
+    // (zeros, the causal padding, at the beginning):
+    auto historySize = (ww[1] - 1) * _dilation;
+    auto channels = ww[2];
+    std::vector<Tensor>& state = *layerData.state;
+
+    if(state.empty())
+    {
+        state.emplace_back(historySize, channels);
+        state[0].fill(0);
+    }
+    else if(state.size() != 1 || state[0].getDims().size() != 2 || state[0].getDims()[0] < historySize ||
+            state[0].getDims()[1] != channels)
+    {
+        PT_LOG_ERROR << "Invalid Conv1D state" << std::endl;
+        return false;
+    }
+
+    // New output steps are computed from the history followed by the new input steps, without padding.
+    // Resizing keeps the history and only reallocates the window if more steps than before are given:
+    auto steps = iw[0];
+    Tensor& window = state[0];
+    window.resize(historySize + steps, channels);
+
+    auto historyEnd = window.begin() + std::ptrdiff_t(historySize * channels);
+    std::copy(in.begin(), in.end(), historyEnd);
+    std::swap(layerData.in, window);
+    _apply(layerData, 0, steps);
+    std::swap(layerData.in, window);
+
+    // The last inputs are shifted in place to the window start to become the next history:
+    std::copy(window.end() - std::ptrdiff_t(historySize * channels), window.end(), window.begin());
+    return true;
+}
+
+void Conv1DLayer::_apply(LayerData& layerData, int padLeft, std::size_t outSize) const
+{
+    const auto& ww = _weightsDims;
+    Conv1DParams params{ int(_stride), int(_dilation), padLeft };
+    Tensor& out = layerData.out;
+    out.resize(outSize, ww[0]);
+
+    if(_filtersPath)
+    {
+        if(PT_LOOP_UNROLLING_ENABLE && ww[0] % (Tensor::VectorSize * 2) == 0)
+        {
+            filtersImpl<2>(_weights, _biases, params, layerData);
+        }
+        else
+        {
+            filtersImpl<1>(_weights, _biases, params, layerData);
+        }
     }
     else
     {
-        multiplyAddImpl<ScalarMultiplyAdd>(_weights, _biases, layerData);
+        // Partial kernel windows start at channel boundaries, so vectors must fit in the channels count:
+        auto channels = ww[2];
+
+        if(PT_LOOP_UNROLLING_ENABLE && channels % (Tensor::VectorSize * 2) == 0)
+        {
+            multiplyAddImpl<Vector2MultiplyAdd>(_weights, _biases, params, layerData);
+        }
+        else if(channels % Tensor::VectorSize == 0)
+        {
+            multiplyAddImpl<VectorMultiplyAdd>(_weights, _biases, params, layerData);
+        }
+        else
+        {
+            multiplyAddImpl<ScalarMultiplyAdd>(_weights, _biases, params, layerData);
+        }
     }
 
     _activation->apply(out);
-    return true;
 }
 
-Conv1DLayer::Conv1DLayer(Tensor&& weights, Tensor&& biases,
-                         std::unique_ptr<ActivationLayer>&& activation) noexcept :
+Conv1DLayer::Conv1DLayer(Tensor::DimsVector&& weightsDims, Tensor&& weights, Tensor&& biases,
+                         std::unique_ptr<ActivationLayer>&& activation, std::size_t stride, std::size_t dilation,
+                         Padding padding, bool filtersPath) noexcept :
+    _weightsDims(std::move(weightsDims)),
     _weights(std::move(weights)),
     _biases(std::move(biases)),
-    _activation(std::move(activation))
+    _activation(std::move(activation)),
+    _stride(stride),
+    _dilation(dilation),
+    _padding(padding),
+    _filtersPath(filtersPath)
 {
 }
 
@@ -23,11 +23,31 @@ public:
     bool apply(LayerData& layerData) const final;
 
 protected:
+    enum Padding
+    {
+        Valid = 0,
+        Same = 1,
+        Causal = 2
+    };
+
+    // Weights are stored as (outputs, steps, depth) for the kernel windows path
+    // and packed as (steps, depth, outputs) for the output filters path:
+    Tensor::DimsVector _weightsDims;
     Tensor _weights;
     Tensor _biases;
     std::unique_ptr<ActivationLayer> _activation;
+    std::size_t _stride;
+    std::size_t _dilation;
+    Padding _padding;
+    bool _filtersPath;
 
-    Conv1DLayer(Tensor&& weights, Tensor&& biases, std::unique_ptr<ActivationLayer>&& activation) noexcept;
+    Conv1DLayer(Tensor::DimsVector&& weightsDims, Tensor&& weights, Tensor&& biases,
+                std::unique_ptr<ActivationLayer>&& activation, std::size_t stride, std::size_t dilation,
+                Padding padding, bool filtersPath) noexcept;
+
+    bool _step(LayerData& layerData) const;
+
+    void _apply(LayerData& layerData, int padLeft, std::size_t outSize) const;
 };
 
 }
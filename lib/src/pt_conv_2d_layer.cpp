@@ -8,9 +8,14 @@
 #include "pt_conv_2d_layer.h"
 
 #include <array>
+#include <algorithm>
+#include "pt_parser.h"
+#include "pt_config.h"
 #include "pt_dispatcher.h"
 #include "pt_layer_data.h"
+#include "pt_max.h"
 #include "pt_multiply_add.h"
+#include "pt_output_tiles.h"
 #include "pt_logger.h"
 
 namespace pt
@@ -18,76 +23,675 @@ namespace pt
 
 namespace
 {
+    struct Conv2DParams
+    {
+        int strideY;
+        int strideX;
+        int dilationY;
+        int dilationX;
+        int padTop;
+        int padLeft;
+    };
+
+    // Block of output pixels computed by a kernel: rows [y, y + rows), columns [colBegin, colEnd) and output
+    // channels [filterBegin, filterEnd). The block starts at out, rows are outRowInc values apart and pixels
+    // are output channels count values apart:
+    struct Conv2DBlock
+    {
+        int y;
+        int rows;
+        int colBegin;
+        int colEnd;
+        int filterBegin;
+        int filterEnd;
+        Tensor::Type* out;
+        int outRowInc;
+    };
+
     template<class MultiplyAddType>
-    void multiplyAddImpl(const Tensor& weights, const Tensor& biases, LayerData& layerData)
+    struct DirectKernel
+    {
+        const Tensor* weights;
+        const Tensor* biases;
+        const Conv2DParams* params;
+        const Tensor* in;
+
+        int rowStep() const noexcept
+        {
+            return 1;
+        }
+
+        int colStep() const noexcept
+        {
+            return 1;
+        }
+
+        std::size_t scratchSize(int) const noexcept
+        {
+            return 0;
+        }
+
+        void operator()(const Conv2DBlock& block, Tensor::Type*) const noexcept
+        {
+            const auto& iw = in->getDims();
+            const auto& ww = weights->getDims();
+            auto outInc = int(ww[0]);
+            auto wInc = int(ww[1] * ww[2] * ww[3]);
+            auto wInc2 = int(ww[2] * ww[3]);
+            auto kh = int(ww[1]);
+            auto kw = int(ww[2]);
+            auto channels = int(ww[3]);
+
+            auto ih = int(iw[0]);
+            auto iwidth = int(iw[1]);
+            auto inIncY = int(ww[3] * iw[1]);
+
+            auto strideY = params->strideY;
+            auto strideX = params->strideX;
+            auto dilationY = params->dilationY;
+            auto dilationX = params->dilationX;
+
+            auto inBegin = in->getData().data();
+            auto wBegin = weights->getData().data();
+            auto bBegin = biases->getData().data();
+            MultiplyAddType multiplyAdd;
+
+            for(int y = block.y, yEnd = block.y + block.rows; y != yEnd; ++y)
+            {
+                // Kernel rows outside of the input are zero padding, so they are skipped:
+                int iy = y * strideY - params->padTop;
+                int kyBegin = iy < 0 ? (dilationY - 1 - iy) / dilationY : 0;
+                int kyEnd = std::min(kh, (ih - iy + dilationY - 1) / dilationY);
+                auto outRow = block.out + (y - block.y) * block.outRowInc;
+
+                for(int x = block.colBegin; x != block.colEnd; ++x)
+                {
+                    // The same goes for kernel columns:
+                    int ix = x * strideX - params->padLeft;
+                    int kxBegin = ix < 0 ? (dilationX - 1 - ix) / dilationX : 0;
+                    int kxEnd = std::min(kw, (iwidth - ix + dilationX - 1) / dilationX);
+                    auto outIt = outRow + (x - block.colBegin) * outInc + block.filterBegin;
+                    auto bIt = bBegin + block.filterBegin;
+
+                    if(kxBegin >= kxEnd)
+                    {
+                        std::copy(bIt, bBegin + block.filterEnd, outIt);
+                        continue;
+                    }
+
+                    for(auto wIt = wBegin + block.filterBegin * wInc, wEnd = wBegin + block.filterEnd * wInc;
+                        wIt != wEnd; wIt += wInc)
+                    {
+                        *outIt = *bIt;
+
+                        for(int ky = kyBegin; ky < kyEnd; ++ky)
+                        {
+                            auto inIt = inBegin + (iy + ky * dilationY) * inIncY + ix * channels;
+                            auto wIt2 = wIt + ky * wInc2;
+
+                            if(dilationX == 1)
+                            {
+                                // Valid kernel columns are contiguous in the input:
+                                *outIt += multiplyAdd(inIt + kxBegin * channels, wIt2 + kxBegin * channels,
+                                                      (kxEnd - kxBegin) * channels);
+                            }
+                            else
+                            {
+                                for(int kx = kxBegin; kx != kxEnd; ++kx)
+                                {
+                                    *outIt += multiplyAdd(inIt + kx * dilationX * channels,
+                                                          wIt2 + kx * channels, channels);
+                                }
+                            }
+                        }
+
+                        ++outIt;
+                        ++bIt;
+                    }
+                }
+            }
+        }
+    };
+
+    constexpr int gemmTilePixels = 4;
+
+    struct GemmTileParams
+    {
+        int filters;
+        int filterBegin;
+        int filterEnd;
+        int channels;
+        int kyBegin;
+        int kyEnd;
+        int kxBegin;
+        int kxEnd;
+        int inIncY;
+        int inIncX;
+        int wIncY;
+        int wIncX;
+    };
+
+    // Implicit GEMM: a tile of output pixels times a block of output channels is accumulated in registers,
+    // reading a broadcast input value and a vector of packed weights for each kernel tap and input channel:
+    template<int Pixels, int Vectors>
+    PT_INLINE void gemmTile(const Tensor::Type* inBegin, const int* inOffsets, const Tensor::Type* wBegin,
+                            const Tensor::Type* bBegin, Tensor::Type* outBegin, const GemmTileParams& params) noexcept
+    {
+        auto filters = params.filters;
+        auto channels = params.channels;
+
+        for(int filter = params.filterBegin; filter != params.filterEnd; filter += Tensor::VectorSize * Vectors)
+        {
+            Tensor::Vector acc[Pixels][Vectors];
+
+            for(int vector = 0; vector != Vectors; ++vector)
+            {
+                Tensor::Vector bias = simdpp::load(bBegin + filter + vector * Tensor::VectorSize);
+
+                for(int pixel = 0; pixel != Pixels; ++pixel)
+                {
+                    acc[pixel][vector] = bias;
+                }
+            }
+
+            for(int ky = params.kyBegin; ky != params.kyEnd; ++ky)
+            {
+                for(int kx = params.kxBegin; kx != params.kxEnd; ++kx)
+                {
+                    auto inOffset = ky * params.inIncY + kx * params.inIncX;
+                    auto wIt = wBegin + ky * params.wIncY + kx * params.wIncX + filter;
+
+                    for(int channel = 0; channel != channels; ++channel)
+                    {
+                        Tensor::Vector w[Vectors];
+
+                        for(int vector = 0; vector != Vectors; ++vector)
+                        {
+                            w[vector] = simdpp::load(wIt + vector * Tensor::VectorSize);
+                        }
+
+                        for(int pixel = 0; pixel != Pixels; ++pixel)
+                        {
+                            Tensor::Vector value = simdpp::splat(inBegin[inOffsets[pixel] + inOffset + channel]);
+
+                            for(int vector = 0; vector != Vectors; ++vector)
+                            {
+                                acc[pixel][vector] = detail::madd(value, w[vector], acc[pixel][vector]);
+                            }
+                        }
+
+                        wIt += filters;
+                    }
+                }
+            }
+
+            for(int pixel = 0; pixel != Pixels; ++pixel)
+            {
+                for(int vector = 0; vector != Vectors; ++vector)
+                {
+                    simdpp::store(outBegin + pixel * filters + filter + vector * Tensor::VectorSize,
+                                  acc[pixel][vector]);
+                }
+            }
+        }
+    }
+
+    template<int Vectors>
+    struct GemmKernel
+    {
+        const Tensor* weights;
+        const Tensor* biases;
+        const Conv2DParams* params;
+        const Tensor* in;
+
+        int rowStep() const noexcept
+        {
+            return 1;
+        }
+
+        int colStep() const noexcept
+        {
+            return gemmTilePixels;
+        }
+
+        std::size_t scratchSize(int) const noexcept
+        {
+            return 0;
+        }
+
+        void operator()(const Conv2DBlock& block, Tensor::Type*) const noexcept
+        {
+            const auto& iw = in->getDims();
+            const auto& ww = weights->getDims();
+            auto kh = int(ww[0]);
+            auto kw = int(ww[1]);
+            auto channels = int(ww[2]);
+            auto filters = int(ww[3]);
+
+            auto ih = int(iw[0]);
+            auto iwidth = int(iw[1]);
+
+            auto strideY = params->strideY;
+            auto strideX = params->strideX;
+            auto dilationY = params->dilationY;
+            auto dilationX = params->dilationX;
+            auto padLeft = params->padLeft;
+
+            GemmTileParams tileParams{ filters, block.filterBegin, block.filterEnd, channels, 0, 0, 0, 0,
+                                       dilationY * iwidth * channels, dilationX * channels,
+                                       kw * channels * filters, channels * filters };
+
+            auto inBegin = in->getData().data();
+            auto wBegin = weights->getData().data();
+            auto bBegin = biases->getData().data();
+
+            // Output columns whose kernel taps are all inside the input:
+            int xInteriorBegin = (padLeft + strideX - 1) / strideX;
+            int xInteriorEnd = std::max(iwidth - 1 - (kw - 1) * dilationX + padLeft, -1) / strideX + 1;
+            xInteriorEnd = std::max(std::min(xInteriorEnd, block.colEnd), xInteriorBegin);
+
+            for(int y = block.y, yEnd = block.y + block.rows; y != yEnd; ++y)
+            {
+                // Kernel rows outside of the input are zero padding, so they are skipped:
+                int iy = y * strideY - params->padTop;
+                tileParams.kyBegin = iy < 0 ? (dilationY - 1 - iy) / dilationY : 0;
+                tileParams.kyEnd = std::max(std::min(kh, (ih - iy + dilationY - 1) / dilationY),
+                                            tileParams.kyBegin);
+
+                auto outIt = block.out + (y - block.y) * block.outRowInc;
+                int inOffsets[gemmTilePixels];
+
+                for(int x = block.colBegin; x != block.colEnd; )
+                {
+                    int ix = x * strideX - padLeft;
+
+                    if(x >= xInteriorBegin && x + gemmTilePixels <= xInteriorEnd)
+                    {
+                        for(int pixel = 0; pixel != gemmTilePixels; ++pixel)
+                        {
+                            inOffsets[pixel] = (iy * iwidth + ix + pixel * strideX) * channels;
+                        }
+
+                        tileParams.kxBegin = 0;
+                        tileParams.kxEnd = kw;
+                        gemmTile<gemmTilePixels, Vectors>(inBegin, inOffsets, wBegin, bBegin, outIt, tileParams);
+                        outIt += gemmTilePixels * filters;
+                        x += gemmTilePixels;
+                    }
+                    else
+                    {
+                        // Border pixels skip padded kernel columns:
+                        inOffsets[0] = (iy * iwidth + ix) * channels;
+                        tileParams.kxBegin = ix < 0 ? (dilationX - 1 - ix) / dilationX : 0;
+                        tileParams.kxEnd = std::max(std::min(kw, (iwidth - ix + dilationX - 1) / dilationX),
+                                                    tileParams.kxBegin);
+                        gemmTile<1, Vectors>(inBegin, inOffsets, wBegin, bBegin, outIt, tileParams);
+                        outIt += filters;
+                        ++x;
+                    }
+                }
+            }
+        }
+    };
+
+    Tensor packGemmWeights(const Tensor& weights)
+    {
+        // (outputs, rows, cols, depth) to (rows, cols, depth, outputs):
+        const auto& ww = weights.getDims();
+        auto filters = ww[0];
+        auto taps = ww[1] * ww[2] * ww[3];
+        Tensor packed(ww[1], ww[2], ww[3], filters);
+        auto wIt = weights.begin();
+        auto packedBegin = packed.begin();
+
+        for(std::size_t filter = 0; filter != filters; ++filter)
+        {
+            for(std::size_t tap = 0; tap != taps; ++tap)
+            {
+                packedBegin[long(tap * filters + filter)] = *wIt;
+                ++wIt;
+            }
+        }
+
+        return packed;
+    }
+
+    constexpr int winogradTileTiles = 4;
+
+    // Winograd products of a tile of input tiles times a block of output channels, for one transformed position:
+    template<int Tiles, int Vectors>
+    PT_INLINE void winogradTile(const Tensor::Type* vBegin, const Tensor::Type* uBegin, Tensor::Type* mBegin,
+                                int channels, int filters, int filterBegin, int filterEnd) noexcept
+    {
+        for(int filter = filterBegin; filter != filterEnd; filter += Tensor::VectorSize * Vectors)
+        {
+            Tensor::Vector acc[Tiles][Vectors];
+
+            for(int tile = 0; tile != Tiles; ++tile)
+            {
+                for(int vector = 0; vector != Vectors; ++vector)
+                {
+                    acc[tile][vector] = makeVector(Tensor::Type(0));
+                }
+            }
+
+            auto uIt = uBegin + filter;
+
+            for(int channel = 0; channel != channels; ++channel)
+            {
+                Tensor::Vector u[Vectors];
+
+                for(int vector = 0; vector != Vectors; ++vector)
+                {
+                    u[vector] = simdpp::load(uIt + vector * Tensor::VectorSize);
+                }
+
+                for(int tile = 0; tile != Tiles; ++tile)
+                {
+                    Tensor::Vector value = simdpp::splat(vBegin[tile * channels + channel]);
+
+                    for(int vector = 0; vector != Vectors; ++vector)
+                    {
+                        acc[tile][vector] = detail::madd(value, u[vector], acc[tile][vector]);
+                    }
+                }
+
+                uIt += filters;
+            }
+
+            for(int tile = 0; tile != Tiles; ++tile)
+            {
+                for(int vector = 0; vector != Vectors; ++vector)
+                {
+                    simdpp::store(mBegin + tile * filters + filter + vector * Tensor::VectorSize, acc[tile][vector]);
+                }
+            }
+        }
+    }
+
+    // Winograd F(2x2, 3x3): each 2x2 output tile is computed from a 4x4 input tile with 16 multiplications
+    // per input and output channel instead of 36. The input tiles of a block are transformed first, so the
+    // products become 16 small GEMMs (one per transformed position) followed by the output transform:
+    template<int Vectors>
+    struct WinogradKernel
+    {
+        const Tensor* weights;
+        const Tensor* biases;
+        const Conv2DParams* params;
+        const Tensor* in;
+
+        int rowStep() const noexcept
+        {
+            return 2;
+        }
+
+        int colStep() const noexcept
+        {
+            return winogradTileTiles * 2;
+        }
+
+        std::size_t scratchSize(int maxCols) const noexcept
+        {
+            const auto& ww = weights->getDims();
+            auto maxTiles = std::size_t(maxCols + 1) / 2;
+            return 16 * maxTiles * (ww[1] + ww[2]);
+        }
+
+        void operator()(const Conv2DBlock& block, Tensor::Type* scratch) const noexcept
+        {
+            const auto& iw = in->getDims();
+            const auto& ww = weights->getDims();
+            auto channels = int(ww[1]);
+            auto filters = int(ww[2]);
+
+            auto ih = int(iw[0]);
+            auto iwidth = int(iw[1]);
+            auto tilesCount = (block.colEnd - block.colBegin + 1) / 2;
+            auto filterBegin = block.filterBegin;
+            auto filterEnd = block.filterEnd;
+
+            auto inBegin = in->getData().data();
+            auto uBegin = weights->getData().data();
+            auto bBegin = biases->getData().data();
+
+            // Products go first in the scratch buffer, since they are read and written with vectors:
+            auto mBegin = scratch;
+            auto vBegin = scratch + 16 * tilesCount * filters;
+            int iy = block.y - params->padTop;
+
+            // Input transform (B^T d B), input tile pixels outside of the input are zero padding:
+            for(int tile = 0; tile != tilesCount; ++tile)
+            {
+                int ix = block.colBegin + tile * 2 - params->padLeft;
+                const Tensor::Type* d[16];
+
+                for(int row = 0; row != 4; ++row)
+                {
+                    for(int col = 0; col != 4; ++col)
+                    {
+                        int y = iy + row;
+                        int x = ix + col;
+                        bool inside = y >= 0 && y < ih && x >= 0 && x < iwidth;
+                        d[row * 4 + col] = inside ? inBegin + (y * iwidth + x) * channels : nullptr;
+                    }
+                }
+
+                auto vIt = vBegin + tile * channels;
+                auto vInc = tilesCount * channels;
+
+                for(int channel = 0; channel != channels; ++channel)
+                {
+                    Tensor::Type t[16];
+
+                    for(int index = 0; index != 16; ++index)
+                    {
+                        t[index] = d[index] ? d[index][channel] : 0;
+                    }
+
+                    for(int col = 0; col != 4; ++col)
+                    {
+                        Tensor::Type d0 = t[col];
+                        Tensor::Type d1 = t[4 + col];
+                        Tensor::Type d2 = t[8 + col];
+                        Tensor::Type d3 = t[12 + col];
+                        t[col] = d0 - d2;
+                        t[4 + col] = d1 + d2;
+                        t[8 + col] = d2 - d1;
+                        t[12 + col] = d1 - d3;
+                    }
+
+                    for(int row = 0; row != 16; row += 4)
+                    {
+                        Tensor::Type d0 = t[row];
+                        Tensor::Type d1 = t[row + 1];
+                        Tensor::Type d2 = t[row + 2];
+                        Tensor::Type d3 = t[row + 3];
+                        vIt[(row + 0) * vInc + channel] = d0 - d2;
+                        vIt[(row + 1) * vInc + channel] = d1 + d2;
+                        vIt[(row + 2) * vInc + channel] = d2 - d1;
+                        vIt[(row + 3) * vInc + channel] = d1 - d3;
+                    }
+                }
+            }
+
+            // Element-wise products, accumulated over input channels:
+            for(int position = 0; position != 16; ++position)
+            {
+                auto vIt = vBegin + position * tilesCount * channels;
+                auto uIt = uBegin + position * channels * filters;
+                auto mIt = mBegin + position * tilesCount * filters;
+                int tile = 0;
+
+                for(; tile + winogradTileTiles <= tilesCount; tile += winogradTileTiles)
+                {
+                    winogradTile<winogradTileTiles, Vectors>(vIt + tile * channels, uIt, mIt + tile * filters,
+                                                             channels, filters, filterBegin, filterEnd);
+                }
+
+                for(; tile != tilesCount; ++tile)
+                {
+                    winogradTile<1, Vectors>(vIt + tile * channels, uIt, mIt + tile * filters, channels, filters,
+                                             filterBegin, filterEnd);
+                }
+            }
+
+            // Output transform (A^T m A):
+            auto mInc = tilesCount * filters;
+
+            for(int tile = 0; tile != tilesCount; ++tile)
+            {
+                int ox = tile * 2;
+
+                for(int filter = filterBegin; filter != filterEnd; filter += Tensor::VectorSize)
+                {
+                    auto mIt = mBegin + tile * filters + filter;
+                    Tensor::Vector t[8];
+
+                    for(int col = 0; col != 4; ++col)
+                    {
+                        Tensor::Vector m0 = simdpp::load(mIt + col * mInc);
+                        Tensor::Vector m1 = simdpp::load(mIt + (4 + col) * mInc);
+                        Tensor::Vector m2 = simdpp::load(mIt + (8 + col) * mInc);
+                        Tensor::Vector m3 = simdpp::load(mIt + (12 + col) * mInc);
+                        t[col] = simdpp::add(simdpp::add(m0, m1), m2);
+                        t[4 + col] = simdpp::sub(simdpp::sub(m1, m2), m3);
+                    }
+
+                    Tensor::Vector bias = simdpp::load(bBegin + filter);
+
+                    for(int row = 0; row != block.rows; ++row)
+                    {
+                        auto tIt = t + row * 4;
+                        auto outIt = block.out + row * block.outRowInc + ox * filters + filter;
+                        Tensor::Vector y0 = simdpp::add(simdpp::add(tIt[0], tIt[1]), tIt[2]);
+                        simdpp::store(outIt, simdpp::add(y0, bias));
+
+                        if(block.colBegin + ox + 1 < block.colEnd)
+                        {
+                            Tensor::Vector y1 = simdpp::sub(simdpp::sub(tIt[1], tIt[2]), tIt[3]);
+                            simdpp::store(outIt + filters, simdpp::add(y1, bias));
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    // Output tiles are computed block by block and written to the output tensor:
+    template<class Kernel>
+    void convImpl(const Kernel& kernel, int channelStep, LayerData& layerData)
     {
         struct Task
         {
-            const Tensor* weights;
-            const Tensor* biases;
+            const Kernel* kernel;
+            const OutputTiles* tiles;
             LayerData* layerData;
-            int threads;
             int taskId;
 
-            void operator()() noexcept
+            void operator()()
             {
-                const Tensor& in = layerData->in;
                 Tensor& out = layerData->out;
-
-                const auto& iw = in.getDims();
-                const auto& ww = weights->getDims();
                 const auto& ow = out.getDims();
-                auto outInc = int(ow[2]);
-                auto wSize = int(ww[0] * ww[1] * ww[2] * ww[3]);
-                auto wInc = int(ww[1] * ww[2] * ww[3]);
-                auto wInc2 = int(ww[2] * ww[3]);
-
-                auto tx = int(ow[1]);
                 auto ty = int(ow[0]);
-                auto inIncX = int(ww[3]);
-                auto inIncY = int(ww[3] * iw[1]);
-
-                auto inBegin = in.getData().data();
+                auto tx = int(ow[1]);
+                auto filters = int(ow[2]);
                 auto outBegin = const_cast<Tensor::Type*>(out.getData().data());
-                auto wBegin = weights->getData().data();
-                auto bBegin = biases->getData().data();
-                MultiplyAddType multiplyAdd;
+                auto rowStep = kernel->rowStep();
+                Tensor::DataVector scratch(kernel->scratchSize(tiles->maxCols()));
 
-                int its = ty;
-                int taskIts = its / threads;
-                int taskBegin = taskIts * taskId;
-                int taskEnd;
-
-                if(taskId == threads - 1)
-                {
-                    taskEnd = its;
-                }
-                else
+                for(int index = tiles->taskBegin(taskId), end = tiles->taskEnd(taskId); index != end; ++index)
                 {
-                    taskEnd = taskBegin + taskIts;
+                    OutputTiles::Tile tile = tiles->tile(index);
+                    int y = tile.row * rowStep;
+                    Conv2DBlock block{ y, std::min(rowStep, ty - y), tile.colBegin, tile.colEnd, tile.channelBegin,
+                                       tile.channelEnd, outBegin + (y * tx + tile.colBegin) * filters,
+                                       tx * filters };
+                    (*kernel)(block, scratch.data());
                 }
+            }
+        };
+
+        std::array<Task, PT_MAX_CPU_THREADS> tasks;
+        Dispatcher& dispatcher = layerData.dispatcher;
+        auto threads = int(dispatcher.threads());
+        const auto& ow = layerData.out.getDims();
+        auto rowStep = kernel.rowStep();
+        OutputTiles tiles{ (int(ow[0]) + rowStep - 1) / rowStep, int(ow[1]), int(ow[2]), kernel.colStep(),
+                           channelStep, threads };
 
-                for(int y = taskBegin; y != taskEnd; ++y)
+        for(int taskId = 0; taskId != threads; ++taskId)
+        {
+            Task& task = tasks[std::size_t(taskId)];
+            task = Task{ &kernel, &tiles, &layerData, taskId };
+            dispatcher.add([&task]{ task(); });
+        }
+
+        dispatcher.join();
+    }
+
+    // Fused max pooling: the output tensor holds pooled values, and the convolution outputs of each block of
+    // pooling windows are only stored in a small scratch buffer:
+    template<class Kernel, class MaxType>
+    void convMaxPoolImpl(const Kernel& kernel, int channelStep, int poolSizeY, int poolSizeX, LayerData& layerData)
+    {
+        struct Task
+        {
+            const Kernel* kernel;
+            const OutputTiles* tiles;
+            LayerData* layerData;
+            int poolSizeY;
+            int poolSizeX;
+            int taskId;
+
+            void operator()()
+            {
+                Tensor& out = layerData->out;
+                const auto& ow = out.getDims();
+                auto tx = int(ow[1]);
+                auto filters = int(ow[2]);
+                auto outBegin = const_cast<Tensor::Type*>(out.getData().data());
+                auto rowStep = kernel->rowStep();
+                auto maxCols = tiles->maxCols() * poolSizeX;
+                Tensor::DataVector conv(std::size_t(rowStep * maxCols * filters));
+                Tensor::DataVector scratch(kernel->scratchSize(maxCols));
+                MaxType max;
+
+                for(int index = tiles->taskBegin(taskId), end = tiles->taskEnd(taskId); index != end; ++index)
                 {
-                    for(int x = 0; x != tx; ++x)
+                    OutputTiles::Tile tile = tiles->tile(index);
+                    int colBegin = tile.colBegin * poolSizeX;
+                    int colEnd = tile.colEnd * poolSizeX;
+                    int convRowInc = (colEnd - colBegin) * filters;
+                    int size = tile.channelEnd - tile.channelBegin;
+                    auto outRow = outBegin + tile.row * tx * filters + tile.channelBegin;
+
+                    for(int x = tile.colBegin; x != tile.colEnd; ++x)
+                    {
+                        auto outIt = outRow + x * filters;
+                        std::fill(outIt, outIt + size, -std::numeric_limits<Tensor::Type>::infinity());
+                    }
+
+                    for(int y = tile.row * poolSizeY, yEnd = y + poolSizeY; y < yEnd; y += rowStep)
                     {
-                        auto inIt = inBegin + y * inIncY + x * inIncX;
-                        auto outIt = outBegin + y * tx * outInc + x * outInc;
-                        auto bIt = bBegin;
+                        int rows = std::min(rowStep, yEnd - y);
+                        Conv2DBlock block{ y, rows, colBegin, colEnd, tile.channelBegin, tile.channelEnd,
+                                           conv.data(), convRowInc };
+                        (*kernel)(block, scratch.data());
 
-                        for(auto wIt = wBegin, wEnd = wBegin + wSize; wIt != wEnd; wIt += wInc)
+                        for(int row = 0; row != rows; ++row)
                         {
-                            auto inIt2 = inIt;
-                            *outIt = *bIt;
+                            auto convIt = conv.data() + row * convRowInc + tile.channelBegin;
 
-                            for(auto wIt2 = wIt, wEnd2 = wIt + wInc; wIt2 != wEnd2; wIt2 += wInc2)
+                            for(int x = tile.colBegin; x != tile.colEnd; ++x)
                             {
-                                *outIt += multiplyAdd(&*inIt2, &*wIt2, wInc2);
-                                inIt2 += inIncY;
-                            }
+                                auto outIt = outRow + x * filters;
 
-                            ++outIt;
-                            ++bIt;
+                                for(int poolX = 0; poolX != poolSizeX; ++poolX)
+                                {
+                                    max(convIt, outIt, size);
+                                    convIt += filters;
+                                }
+                            }
                         }
                     }
                 }
@@ -97,16 +701,93 @@ namespace
         std::array<Task, PT_MAX_CPU_THREADS> tasks;
         Dispatcher& dispatcher = layerData.dispatcher;
         auto threads = int(dispatcher.threads());
+        const auto& ow = layerData.out.getDims();
+        OutputTiles tiles{ int(ow[0]), int(ow[1]), int(ow[2]), std::max(kernel.colStep() / poolSizeX, 1),
+                           channelStep, threads };
 
         for(int taskId = 0; taskId != threads; ++taskId)
         {
             Task& task = tasks[std::size_t(taskId)];
-            task = Task{ &weights, &biases, &layerData, threads, taskId };
+            task = Task{ &kernel, &tiles, &layerData, poolSizeY, poolSizeX, taskId };
             dispatcher.add([&task]{ task(); });
         }
 
         dispatcher.join();
     }
+
+    template<class Kernel>
+    void kernelImpl(const Kernel& kernel, int channelStep, int poolSizeY, int poolSizeX, LayerData& layerData)
+    {
+        if(poolSizeY == 1 && poolSizeX == 1)
+        {
+            convImpl(kernel, channelStep, layerData);
+        }
+        else if(PT_LOOP_UNROLLING_ENABLE && channelStep % (Tensor::VectorSize * 2) == 0)
+        {
+            convMaxPoolImpl<Kernel, Vector2Max>(kernel, channelStep, poolSizeY, poolSizeX, layerData);
+        }
+        else if(channelStep % Tensor::VectorSize == 0)
+        {
+            convMaxPoolImpl<Kernel, VectorMax>(kernel, channelStep, poolSizeY, poolSizeX, layerData);
+        }
+        else
+        {
+            convMaxPoolImpl<Kernel, ScalarMax>(kernel, channelStep, poolSizeY, poolSizeX, layerData);
+        }
+    }
+
+    Tensor transformWinogradWeights(const Tensor& weights)
+    {
+        // G g G^T for each output and input channel, stored as (16, depth, outputs):
+        const auto& ww = weights.getDims();
+        auto filters = ww[0];
+        auto channels = ww[3];
+        Tensor transformed(16, channels, filters);
+        auto wBegin = weights.begin();
+        auto transformedBegin = transformed.begin();
+
+        for(std::size_t filter = 0; filter != filters; ++filter)
+        {
+            for(std::size_t channel = 0; channel != channels; ++channel)
+            {
+                Tensor::Type g[9];
+
+                for(std::size_t index = 0; index != 9; ++index)
+                {
+                    g[index] = wBegin[long((filter * 9 + index) * channels + channel)];
+                }
+
+                Tensor::Type t[12];
+
+                for(int col = 0; col != 3; ++col)
+                {
+                    Tensor::Type g0 = g[col];
+                    Tensor::Type g1 = g[3 + col];
+                    Tensor::Type g2 = g[6 + col];
+                    t[col] = g0;
+                    t[3 + col] = (g0 + g1 + g2) / 2;
+                    t[6 + col] = (g0 - g1 + g2) / 2;
+                    t[9 + col] = g2;
+                }
+
+                for(int row = 0; row != 4; ++row)
+                {
+                    Tensor::Type t0 = t[row * 3];
+                    Tensor::Type t1 = t[row * 3 + 1];
+                    Tensor::Type t2 = t[row * 3 + 2];
+                    Tensor::Type u[4] = { t0, (t0 + t1 + t2) / 2, (t0 - t1 + t2) / 2, t2 };
+
+                    for(int col = 0; col != 4; ++col)
+                    {
+                        auto index = (std::size_t(row * 4 + col) * channels + channel) * filters + filter;
+                        transformedBegin[long(index)] = u[col];
+                    }
+                }
+            }
+        }
+
+        return transformed;
+    }
 }
 
 std::unique_ptr<Conv2DLayer> Conv2DLayer::create(std::istream& stream)
@@ -135,14 +816,126 @@ std::unique_ptr<Conv2DLayer> Conv2DLayer::create(std::istream& stream)
         return nullptr;
     }
 
-    return std::unique_ptr<Conv2DLayer>(new Conv2DLayer(std::move(*weights), std::move(*biases),
-                                                        std::move(activation)));
+    unsigned int strideY = 0;
+    unsigned int strideX = 0;
+
+    if(! Parser::parse(stream, strideY) || ! Parser::parse(stream, strideX))
+    {
+        PT_LOG_ERROR << "Strides parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(strideY == 0 || strideX == 0)
+    {
+        PT_LOG_ERROR << "Invalid strides: " << strideY << ", " << strideX << std::endl;
+        return nullptr;
+    }
+
+    unsigned int samePadding = 0;
+
+    if(! Parser::parse(stream, samePadding))
+    {
+        PT_LOG_ERROR << "Padding parse failed" << std::endl;
+        return nullptr;
+    }
+
+    unsigned int dilationY = 0;
+    unsigned int dilationX = 0;
+
+    if(! Parser::parse(stream, dilationY) || ! Parser::parse(stream, dilationX))
+    {
+        PT_LOG_ERROR << "Dilation rate parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(dilationY == 0 || dilationX == 0)
+    {
+        PT_LOG_ERROR << "Invalid dilation rate: " << dilationY << ", " << dilationX << std::endl;
+        return nullptr;
+    }
+
+    // Deep layers use the implicit GEMM path, which vectorizes output channels:
+    auto weightsDims = weights->getDims();
+    auto filters = weightsDims[0];
+    auto channels = weightsDims[3];
+    bool gemm = filters % Tensor::VectorSize == 0 && filters >= PT_CONV_2D_GEMM_MIN_CHANNELS &&
+                channels >= PT_CONV_2D_GEMM_MIN_CHANNELS;
+
+    // 3x3 stride 1 layers can also use the Winograd algorithm:
+    Tensor winogradWeights;
+
+    if(weightsDims[1] == 3 && weightsDims[2] == 3 && strideY == 1 && strideX == 1 && dilationY == 1 &&
+            dilationX == 1 && filters % Tensor::VectorSize == 0)
+    {
+        winogradWeights = transformWinogradWeights(*weights);
+    }
+
+    if(gemm)
+    {
+        *weights = packGemmWeights(*weights);
+    }
+
+    return std::unique_ptr<Conv2DLayer>(new Conv2DLayer(std::move(weightsDims), std::move(*weights),
+                                                        std::move(winogradWeights), std::move(*biases),
+                                                        std::move(activation), strideY, strideX, dilationY,
+                                                        dilationX, samePadding, gemm));
 }
 
 bool Conv2DLayer::apply(LayerData& layerData) const
 {
-    const Tensor& in = layerData.in;
-    const auto& iw = in.getDims();
+    Geometry geometry;
+
+    if(! _geometry(layerData.in.getDims(), geometry))
+    {
+        return false;
+    }
+
+    _apply(layerData, geometry, 1, 1);
+    return true;
+}
+
+bool Conv2DLayer::getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const
+{
+    Geometry geometry;
+
+    if(! _geometry(inDims, geometry))
+    {
+        return false;
+    }
+
+    outDims = { std::size_t(geometry.outY), std::size_t(geometry.outX), _weightsDims[0] };
+    return true;
+}
+
+SpatialLayer::Region Conv2DLayer::getInputRegion(const Tensor::DimsVector& inDims,
+                                                 const Region& outRegion) const noexcept
+{
+    Geometry geometry;
+    _geometry(inDims, geometry);
+
+    // Dilated kernel size:
+    auto kernelY = int((_weightsDims[1] - 1) * _dilationY + 1);
+    auto kernelX = int((_weightsDims[2] - 1) * _dilationX + 1);
+
+    int yBegin = std::max(outRegion.y * int(_strideY) - geometry.padTop, 0);
+    int xBegin = std::max(outRegion.x * int(_strideX) - geometry.padLeft, 0);
+    int yEnd = (outRegion.y + outRegion.rows - 1) * int(_strideY) - geometry.padTop + kernelY;
+    int xEnd = (outRegion.x + outRegion.cols - 1) * int(_strideX) - geometry.padLeft + kernelX;
+    yEnd = std::min(yEnd, int(inDims[0]));
+    xEnd = std::min(xEnd, int(inDims[1]));
+    return Region{ yBegin, xBegin, yEnd - yBegin, xEnd - xBegin };
+}
+
+bool Conv2DLayer::applyTile(LayerData& layerData, const Tensor::DimsVector& inDims, const Region& inRegion,
+                            const Region& outRegion) const
+{
+    _apply(layerData, _tileGeometry(inDims, inRegion, outRegion), 1, 1);
+    return true;
+}
+
+bool Conv2DLayer::_geometry(const Tensor::DimsVector& inDims, Geometry& geometry) const
+{
+    const auto& iw = inDims;
 
     if(iw.size() != 3)
     {
@@ -151,7 +944,7 @@ bool Conv2DLayer::apply(LayerData& layerData) const
         return false;
     }
 
-    const auto& ww = _weights.getDims();
+    const auto& ww = _weightsDims;
 
     if(iw[2] != ww[3])
     {
@@ -161,36 +954,138 @@ bool Conv2DLayer::apply(LayerData& layerData) const
         return false;
     }
 
-    auto offsetY = ww[1] - 1;
-    auto offsetX = ww[2] - 1;
+    // Dilated kernel size:
+    auto kernelY = (ww[1] - 1) * _dilationY + 1;
+    auto kernelX = (ww[2] - 1) * _dilationX + 1;
+
+    if(_samePadding)
+    {
+        // Same as TensorFlow, extra padding goes to the bottom and right sides:
+        auto outY = (iw[0] + _strideY - 1) / _strideY;
+        auto outX = (iw[1] + _strideX - 1) / _strideX;
+
+        auto padY = (outY - 1) * _strideY + kernelY;
+        auto padX = (outX - 1) * _strideX + kernelX;
+        geometry.outY = int(outY);
+        geometry.outX = int(outX);
+        geometry.padTop = padY > iw[0] ? int(padY - iw[0]) / 2 : 0;
+        geometry.padLeft = padX > iw[1] ? int(padX - iw[1]) / 2 : 0;
+    }
+    else
+    {
+        if(iw[0] < kernelY || iw[1] < kernelX)
+        {
+            PT_LOG_ERROR << "Input tensor is smaller than the kernel" <<
+                                " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                                " (weights dims: " << VectorPrinter<std::size_t>{ ww } << ")" << std::endl;
+            return false;
+        }
+
+        geometry.outY = int((iw[0] - kernelY) / _strideY + 1);
+        geometry.outX = int((iw[1] - kernelX) / _strideX + 1);
+        geometry.padTop = 0;
+        geometry.padLeft = 0;
+    }
+
+    return true;
+}
+
+Conv2DLayer::Geometry Conv2DLayer::_tileGeometry(const Tensor::DimsVector& inDims, const Region& inRegion,
+                                                 const Region& outRegion) const noexcept
+{
+    // The input tile covers all the valid kernel taps of the output tile, so taps outside of it are padding:
+    Geometry geometry;
+    _geometry(inDims, geometry);
+
+    geometry.outY = outRegion.rows;
+    geometry.outX = outRegion.cols;
+    geometry.padTop += inRegion.y - outRegion.y * int(_strideY);
+    geometry.padLeft += inRegion.x - outRegion.x * int(_strideX);
+    return geometry;
+}
+
+void Conv2DLayer::_apply(LayerData& layerData, const Geometry& geometry, int poolSizeY, int poolSizeX) const
+{
+    const auto& ww = _weightsDims;
+    Conv2DParams params{ int(_strideY), int(_strideX), int(_dilationY), int(_dilationX), geometry.padTop,
+                         geometry.padLeft };
+    const Tensor& in = layerData.in;
+
+    // Pooled outputs are written directly, so only the convolution of full pooling windows is computed:
     Tensor& out = layerData.out;
-    out.resize(iw[0] - offsetY, iw[1] - offsetX, ww[0]);
+    out.resize(std::size_t(geometry.outY / poolSizeY), std::size_t(geometry.outX / poolSizeX), ww[0]);
 
-    auto threads = int(layerData.dispatcher.threads());
-    auto threadSize = int(ww[2] * ww[3]) / threads;
+    auto filters = ww[0];
 
-    if(PT_LOOP_UNROLLING_ENABLE && threadSize && threadSize % (Tensor::VectorSize * 2) == 0)
+    if(_winogradWeights.isValid() && layerData.config.getConv2DWinograd())
     {
-        multiplyAddImpl<Vector2MultiplyAdd>(_weights, _biases, layerData);
+        if(PT_LOOP_UNROLLING_ENABLE && filters % (Tensor::VectorSize * 2) == 0)
+        {
+            WinogradKernel<2> kernel{ &_winogradWeights, &_biases, &params, &in };
+            kernelImpl(kernel, Tensor::VectorSize * 2, poolSizeY, poolSizeX, layerData);
+        }
+        else
+        {
+            WinogradKernel<1> kernel{ &_winogradWeights, &_biases, &params, &in };
+            kernelImpl(kernel, Tensor::VectorSize, poolSizeY, poolSizeX, layerData);
+        }
     }
-    else if(threadSize && threadSize % Tensor::VectorSize == 0)
+    else if(_gemm)
     {
-        multiplyAddImpl<VectorMultiplyAdd>(_weights, _biases, layerData);
+        if(PT_LOOP_UNROLLING_ENABLE && filters % (Tensor::VectorSize * 2) == 0)
+        {
+            GemmKernel<2> kernel{ &_weights, &_biases, &params, &in };
+            kernelImpl(kernel, Tensor::VectorSize * 2, poolSizeY, poolSizeX, layerData);
+        }
+        else
+        {
+            GemmKernel<1> kernel{ &_weights, &_biases, &params, &in };
+            kernelImpl(kernel, Tensor::VectorSize, poolSizeY, poolSizeX, layerData);
+        }
     }
     else
     {
-        multiplyAddImpl<ScalarMultiplyAdd>(_weights, _biases, layerData);
+        // Partial kernel rows start at channel boundaries, so vectors must fit in the channels count.
+        // Output channels are computed one by one, but fused pooling can use vectors if they fit:
+        auto channels = ww[3];
+        int channelStep = filters % Tensor::VectorSize == 0 ? int(Tensor::VectorSize) : 1;
+
+        if(PT_LOOP_UNROLLING_ENABLE && channels % (Tensor::VectorSize * 2) == 0)
+        {
+            DirectKernel<Vector2MultiplyAdd> kernel{ &_weights, &_biases, &params, &in };
+            kernelImpl(kernel, channelStep, poolSizeY, poolSizeX, layerData);
+        }
+        else if(channels % Tensor::VectorSize == 0)
+        {
+            DirectKernel<VectorMultiplyAdd> kernel{ &_weights, &_biases, &params, &in };
+            kernelImpl(kernel, channelStep, poolSizeY, poolSizeX, layerData);
+        }
+        else
+        {
+            DirectKernel<ScalarMultiplyAdd> kernel{ &_weights, &_biases, &params, &in };
+            kernelImpl(kernel, channelStep, poolSizeY, poolSizeX, layerData);
+        }
     }
 
+    // Activations are monotonic (softmax layers are never fused), so they can be applied after pooling:
     _activation->apply(out);
-    return true;
 }
 
-Conv2DLayer::Conv2DLayer(Tensor&& weights, Tensor&& biases,
-                         std::unique_ptr<ActivationLayer>&& activation) noexcept :
+Conv2DLayer::Conv2DLayer(Tensor::DimsVector&& weightsDims, Tensor&& weights, Tensor&& winogradWeights,
+                         Tensor&& biases, std::unique_ptr<ActivationLayer>&& activation, std::size_t strideY,
+                         std::size_t strideX, std::size_t dilationY, std::size_t dilationX, bool samePadding,
+                         bool gemm) noexcept :
+    _weightsDims(std::move(weightsDims)),
     _weights(std::move(weights)),
+    _winogradWeights(std::move(winogradWeights)),
     _biases(std::move(biases)),
-    _activation(std::move(activation))
+    _activation(std::move(activation)),
+    _strideY(strideY),
+    _strideX(strideX),
+    _dilationY(dilationY),
+    _dilationX(dilationX),
+    _samePadding(samePadding),
+    _gemm(gemm)
 {
 }
 
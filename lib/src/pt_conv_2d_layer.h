@@ -8,13 +8,12 @@
 #ifndef PT_CONV_2D_LAYER_H
 #define PT_CONV_2D_LAYER_H
 
-#include "pt_tensor.h"
 #include "pt_activation_layer.h"
 
 namespace pt
 {
 
-class Conv2DLayer : public Layer
+class Conv2DLayer : public SpatialLayer
 {
 
 public:
@@ -22,12 +21,49 @@ public:
 
     bool apply(LayerData& layerData) const final;
 
+    bool getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const final;
+
+    Region getInputRegion(const Tensor::DimsVector& inDims, const Region& outRegion) const noexcept final;
+
+    bool applyTile(LayerData& layerData, const Tensor::DimsVector& inDims, const Region& inRegion,
+                   const Region& outRegion) const final;
+
 protected:
+    friend class Conv2DMaxPooling2DLayer;
+
+    struct Geometry
+    {
+        int outY;
+        int outX;
+        int padTop;
+        int padLeft;
+    };
+
+    // Weights are stored as (outputs, rows, cols, depth) for the direct path
+    // and packed as (rows, cols, depth, outputs) for the implicit GEMM path:
+    Tensor::DimsVector _weightsDims;
     Tensor _weights;
+    Tensor _winogradWeights;
     Tensor _biases;
     std::unique_ptr<ActivationLayer> _activation;
+    std::size_t _strideY;
+    std::size_t _strideX;
+    std::size_t _dilationY;
+    std::size_t _dilationX;
+    bool _samePadding;
+    bool _gemm;
+
+    Conv2DLayer(Tensor::DimsVector&& weightsDims, Tensor&& weights, Tensor&& winogradWeights, Tensor&& biases,
+                std::unique_ptr<ActivationLayer>&& activation, std::size_t strideY, std::size_t strideX,
+                std::size_t dilationY, std::size_t dilationX, bool samePadding, bool gemm) noexcept;
+
+    bool _geometry(const Tensor::DimsVector& inDims, Geometry& geometry) const;
+
+    Geometry _tileGeometry(const Tensor::DimsVector& inDims, const Region& inRegion,
+                           const Region& outRegion) const noexcept;
 
-    Conv2DLayer(Tensor&& weights, Tensor&& biases, std::unique_ptr<ActivationLayer>&& activation) noexcept;
+    // Pooled outputs of non-overlapping max pooling windows, without storing the full convolution output:
+    void _apply(LayerData& layerData, const Geometry& geometry, int poolSizeY, int poolSizeX) const;
 };
 
 }
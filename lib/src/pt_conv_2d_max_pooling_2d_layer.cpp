@@ -0,0 +1,166 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_conv_2d_max_pooling_2d_layer.h"
+
+#include "pt_config.h"
+#include "pt_layer_data.h"
+#include "pt_soft_max_activation_layer.h"
+#include "pt_logger.h"
+
+namespace pt
+{
+
+namespace
+{
+    template<class LayerType>
+    std::unique_ptr<LayerType> castLayer(std::unique_ptr<Layer>& layer)
+    {
+        return std::unique_ptr<LayerType>(static_cast<LayerType*>(layer.release()));
+    }
+}
+
+void Conv2DMaxPooling2DLayer::fuse(std::vector<std::unique_ptr<Layer>>& layers)
+{
+    std::vector<std::unique_ptr<Layer>> fusedLayers;
+    std::size_t layersCount = layers.size();
+    std::size_t index = 0;
+
+    while(index != layersCount)
+    {
+        // Activations must be monotonic, since they are applied after pooling:
+        auto conv = dynamic_cast<const Conv2DLayer*>(layers[index].get());
+
+        if(conv && ! dynamic_cast<const SoftMaxActivationLayer*>(conv->_activation.get()))
+        {
+            std::size_t poolIndex = index + 1;
+
+            if(poolIndex != layersCount)
+            {
+                auto activation = dynamic_cast<const ActivationLayer*>(layers[poolIndex].get());
+
+                if(activation && ! dynamic_cast<const SoftMaxActivationLayer*>(activation))
+                {
+                    ++poolIndex;
+                }
+            }
+
+            auto pool = poolIndex != layersCount ?
+                        dynamic_cast<const MaxPooling2DLayer*>(layers[poolIndex].get()) : nullptr;
+
+            if(pool && pool->_isFusable())
+            {
+                std::unique_ptr<ActivationLayer> activation;
+
+                if(poolIndex != index + 1)
+                {
+                    activation = castLayer<ActivationLayer>(layers[index + 1]);
+                }
+
+                fusedLayers.push_back(std::unique_ptr<Layer>(new Conv2DMaxPooling2DLayer(
+                                          castLayer<Conv2DLayer>(layers[index]), std::move(activation),
+                                          castLayer<MaxPooling2DLayer>(layers[poolIndex]))));
+                index = poolIndex + 1;
+                continue;
+            }
+        }
+
+        fusedLayers.push_back(std::move(layers[index]));
+        ++index;
+    }
+
+    layers = std::move(fusedLayers);
+}
+
+bool Conv2DMaxPooling2DLayer::apply(LayerData& layerData) const
+{
+    Conv2DLayer::Geometry geometry;
+
+    if(! _conv->_geometry(layerData.in.getDims(), geometry))
+    {
+        return false;
+    }
+
+    if(geometry.outY < _pool->_poolSizeY || geometry.outX < _pool->_poolSizeX)
+    {
+        PT_LOG_ERROR << "Conv2D output is smaller than the pool size" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ layerData.in.getDims() } << ")" <<
+                            " (pool size: " << _pool->_poolSizeY << ", " << _pool->_poolSizeX << ")" << std::endl;
+        return false;
+    }
+
+    return _apply(layerData, geometry);
+}
+
+bool Conv2DMaxPooling2DLayer::getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const
+{
+    Tensor::DimsVector convDims;
+
+    if(! _conv->getOutputDims(inDims, convDims))
+    {
+        return false;
+    }
+
+    return _pool->getOutputDims(convDims, outDims);
+}
+
+SpatialLayer::Region Conv2DMaxPooling2DLayer::getInputRegion(const Tensor::DimsVector& inDims,
+                                                             const Region& outRegion) const noexcept
+{
+    return _conv->getInputRegion(inDims, _convRegion(outRegion));
+}
+
+bool Conv2DMaxPooling2DLayer::applyTile(LayerData& layerData, const Tensor::DimsVector& inDims,
+                                        const Region& inRegion, const Region& outRegion) const
+{
+    return _apply(layerData, _conv->_tileGeometry(inDims, inRegion, _convRegion(outRegion)));
+}
+
+Conv2DMaxPooling2DLayer::Conv2DMaxPooling2DLayer(std::unique_ptr<Conv2DLayer>&& conv,
+                                                 std::unique_ptr<ActivationLayer>&& activation,
+                                                 std::unique_ptr<MaxPooling2DLayer>&& pool) noexcept :
+    _conv(std::move(conv)),
+    _activation(std::move(activation)),
+    _pool(std::move(pool))
+{
+}
+
+SpatialLayer::Region Conv2DMaxPooling2DLayer::_convRegion(const Region& outRegion) const noexcept
+{
+    int poolSizeY = _pool->_poolSizeY;
+    int poolSizeX = _pool->_poolSizeX;
+    return Region{ outRegion.y * poolSizeY, outRegion.x * poolSizeX, outRegion.rows * poolSizeY,
+                   outRegion.cols * poolSizeX };
+}
+
+bool Conv2DMaxPooling2DLayer::_apply(LayerData& layerData, const Conv2DLayer::Geometry& geometry) const
+{
+    if(layerData.config.getLayerFusion())
+    {
+        _conv->_apply(layerData, geometry, _pool->_poolSizeY, _pool->_poolSizeX);
+
+        if(_activation)
+        {
+            _activation->apply(layerData.out);
+        }
+
+        return true;
+    }
+
+    // Unfused path, the convolution output is fully stored before pooling:
+    _conv->_apply(layerData, geometry, 1, 1);
+
+    if(_activation)
+    {
+        _activation->apply(layerData.out);
+    }
+
+    layerData.in = std::move(layerData.out);
+    return _pool->apply(layerData);
+}
+
+}
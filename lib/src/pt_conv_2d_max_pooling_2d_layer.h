@@ -0,0 +1,50 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_CONV_2D_MAX_POOLING_2D_LAYER_H
+#define PT_CONV_2D_MAX_POOLING_2D_LAYER_H
+
+#include <vector>
+#include "pt_conv_2d_layer.h"
+#include "pt_max_pooling_2d_layer.h"
+
+namespace pt
+{
+
+class Conv2DMaxPooling2DLayer : public SpatialLayer
+{
+
+public:
+    // Replaces Conv2D -> [Activation ->] MaxPooling2D sequences with fused layers:
+    static void fuse(std::vector<std::unique_ptr<Layer>>& layers);
+
+    bool apply(LayerData& layerData) const final;
+
+    bool getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const final;
+
+    Region getInputRegion(const Tensor::DimsVector& inDims, const Region& outRegion) const noexcept final;
+
+    bool applyTile(LayerData& layerData, const Tensor::DimsVector& inDims, const Region& inRegion,
+                   const Region& outRegion) const final;
+
+protected:
+    std::unique_ptr<Conv2DLayer> _conv;
+    std::unique_ptr<ActivationLayer> _activation;
+    std::unique_ptr<MaxPooling2DLayer> _pool;
+
+    Conv2DMaxPooling2DLayer(std::unique_ptr<Conv2DLayer>&& conv, std::unique_ptr<ActivationLayer>&& activation,
+                            std::unique_ptr<MaxPooling2DLayer>&& pool) noexcept;
+
+    // Convolution output region of the given pooled output region:
+    Region _convRegion(const Region& outRegion) const noexcept;
+
+    bool _apply(LayerData& layerData, const Conv2DLayer::Geometry& geometry) const;
+};
+
+}
+
+#endif
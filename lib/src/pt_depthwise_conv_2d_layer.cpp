@@ -0,0 +1,423 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_depthwise_conv_2d_layer.h"
+
+#include <array>
+#include <algorithm>
+#include "pt_parser.h"
+#include "pt_dispatcher.h"
+#include "pt_layer_data.h"
+#include "pt_multiply_add.h"
+#include "pt_output_tiles.h"
+#include "pt_logger.h"
+
+namespace pt
+{
+
+namespace
+{
+    struct DepthwiseRowParams
+    {
+        const Tensor::Type* inBegin;
+        const Tensor::Type* wBegin;
+        const Tensor::Type* bBegin;
+        int inHeight;
+        int inWidth;
+        int inChannels;
+        int channels;
+        int depthMultiplier;
+        int kh;
+        int kw;
+        int strideX;
+        int dilationY;
+        int dilationX;
+        int padLeft;
+    };
+
+    // Output channels are vectorized, reading the same channels of the input (depth multiplier must be 1):
+    template<int Vectors>
+    void vectorRow(const DepthwiseRowParams& params, int iy, int kyBegin, int kyEnd, int colBegin, int colEnd,
+                   int channelBegin, int channelEnd, Tensor::Type* out, int outInc) noexcept
+    {
+        auto dilationX = params.dilationX;
+
+        for(int x = colBegin; x != colEnd; ++x)
+        {
+            // Kernel taps outside of the input are zero padding, so they are skipped:
+            int ix = x * params.strideX - params.padLeft;
+            int kxBegin = ix < 0 ? (dilationX - 1 - ix) / dilationX : 0;
+            int kxEnd = std::min(params.kw, (params.inWidth - ix + dilationX - 1) / dilationX);
+            auto outIt = out + (x - colBegin) * outInc;
+
+            for(int channel = channelBegin; channel != channelEnd; channel += Tensor::VectorSize * Vectors)
+            {
+                Tensor::Vector acc[Vectors];
+
+                for(int vector = 0; vector != Vectors; ++vector)
+                {
+                    if(params.bBegin)
+                    {
+                        acc[vector] = simdpp::load(params.bBegin + channel + vector * Tensor::VectorSize);
+                    }
+                    else
+                    {
+                        acc[vector] = makeVector(Tensor::Type(0));
+                    }
+                }
+
+                for(int ky = kyBegin; ky < kyEnd; ++ky)
+                {
+                    auto inRow = params.inBegin + (iy + ky * params.dilationY) * params.inWidth * params.inChannels;
+
+                    for(int kx = kxBegin; kx < kxEnd; ++kx)
+                    {
+                        auto inIt = inRow + (ix + kx * dilationX) * params.inChannels + channel;
+                        auto wIt = params.wBegin + (ky * params.kw + kx) * params.channels + channel;
+
+                        for(int vector = 0; vector != Vectors; ++vector)
+                        {
+                            int offset = vector * Tensor::VectorSize;
+                            acc[vector] = detail::madd(simdpp::load(inIt + offset), simdpp::load(wIt + offset),
+                                                       acc[vector]);
+                        }
+                    }
+                }
+
+                for(int vector = 0; vector != Vectors; ++vector)
+                {
+                    simdpp::store(outIt + channel + vector * Tensor::VectorSize, acc[vector]);
+                }
+            }
+        }
+    }
+
+    void scalarRow(const DepthwiseRowParams& params, int iy, int kyBegin, int kyEnd, int colBegin, int colEnd,
+                   int channelBegin, int channelEnd, Tensor::Type* out, int outInc) noexcept
+    {
+        auto dilationX = params.dilationX;
+
+        for(int x = colBegin; x != colEnd; ++x)
+        {
+            int ix = x * params.strideX - params.padLeft;
+            int kxBegin = ix < 0 ? (dilationX - 1 - ix) / dilationX : 0;
+            int kxEnd = std::min(params.kw, (params.inWidth - ix + dilationX - 1) / dilationX);
+            auto outIt = out + (x - colBegin) * outInc;
+
+            for(int channel = channelBegin; channel != channelEnd; ++channel)
+            {
+                // Each input channel feeds depth multiplier consecutive output channels:
+                auto inChannel = channel / params.depthMultiplier;
+                Tensor::Type acc = params.bBegin ? params.bBegin[channel] : 0;
+
+                for(int ky = kyBegin; ky < kyEnd; ++ky)
+                {
+                    auto inRow = params.inBegin + (iy + ky * params.dilationY) * params.inWidth * params.inChannels;
+
+                    for(int kx = kxBegin; kx < kxEnd; ++kx)
+                    {
+                        acc += inRow[(ix + kx * dilationX) * params.inChannels + inChannel] *
+                                params.wBegin[(ky * params.kw + kx) * params.channels + channel];
+                    }
+                }
+
+                outIt[channel] = acc;
+            }
+        }
+    }
+}
+
+std::unique_ptr<DepthwiseConv2DLayer> DepthwiseConv2DLayer::create(std::istream& stream)
+{
+    auto layer = _create(stream);
+
+    if(! layer)
+    {
+        return nullptr;
+    }
+
+    auto biases = Tensor::create(1, stream);
+
+    if(! biases)
+    {
+        PT_LOG_ERROR << "Biases tensor parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(biases->getSize() != layer->_weights.getDims()[2])
+    {
+        PT_LOG_ERROR << "Invalid biases tensor dims" <<
+                            " (biases dims: " << VectorPrinter<std::size_t>{ biases->getDims() } << ")" <<
+                            " (weights dims: " << VectorPrinter<std::size_t>{ layer->_weights.getDims() } << ")" <<
+                            std::endl;
+        return nullptr;
+    }
+
+    auto activation = ActivationLayer::create(stream);
+
+    if(! activation)
+    {
+        PT_LOG_ERROR << "Activation layer parse failed" << std::endl;
+        return nullptr;
+    }
+
+    layer->_biases = std::move(*biases);
+    layer->_activation = std::move(activation);
+    return layer;
+}
+
+bool DepthwiseConv2DLayer::apply(LayerData& layerData) const
+{
+    struct Task
+    {
+        const DepthwiseConv2DLayer* layer;
+        const Geometry* geometry;
+        const OutputTiles* tiles;
+        LayerData* layerData;
+        int taskId;
+
+        void operator()() noexcept
+        {
+            Tensor& out = layerData->out;
+            auto channels = int(out.getDims()[2]);
+            auto outBegin = &*out.begin();
+
+            for(int index = tiles->taskBegin(taskId), end = tiles->taskEnd(taskId); index != end; ++index)
+            {
+                OutputTiles::Tile tile = tiles->tile(index);
+                auto outIt = outBegin + (tile.row * geometry->outX + tile.colBegin) * channels;
+                layer->_row(layerData->in, *geometry, tile.row, tile.colBegin, tile.colEnd, tile.channelBegin,
+                            tile.channelEnd, outIt, channels);
+            }
+        }
+    };
+
+    Geometry geometry;
+
+    if(! _geometry(layerData.in, geometry))
+    {
+        return false;
+    }
+
+    Tensor& out = layerData.out;
+    auto channels = _weights.getDims()[2];
+    out.resize(std::size_t(geometry.outY), std::size_t(geometry.outX), channels);
+
+    std::array<Task, PT_MAX_CPU_THREADS> tasks;
+    Dispatcher& dispatcher = layerData.dispatcher;
+    auto threads = int(dispatcher.threads());
+    OutputTiles tiles{ geometry.outY, geometry.outX, int(channels), 1, _channelStep(), threads };
+
+    for(int taskId = 0; taskId != threads; ++taskId)
+    {
+        Task& task = tasks[std::size_t(taskId)];
+        task = Task{ this, &geometry, &tiles, &layerData, taskId };
+        dispatcher.add([&task]{ task(); });
+    }
+
+    dispatcher.join();
+
+    _activation->apply(out);
+    return true;
+}
+
+std::unique_ptr<DepthwiseConv2DLayer> DepthwiseConv2DLayer::_create(std::istream& stream)
+{
+    auto weights = Tensor::create(3, stream);
+
+    if(! weights)
+    {
+        PT_LOG_ERROR << "Weights tensor parse failed" << std::endl;
+        return nullptr;
+    }
+
+    unsigned int depthMultiplier = 0;
+
+    if(! Parser::parse(stream, depthMultiplier))
+    {
+        PT_LOG_ERROR << "Depth multiplier parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(depthMultiplier == 0 || weights->getDims()[2] % depthMultiplier != 0)
+    {
+        PT_LOG_ERROR << "Invalid depth multiplier: " << depthMultiplier << std::endl;
+        return nullptr;
+    }
+
+    unsigned int strideY = 0;
+    unsigned int strideX = 0;
+
+    if(! Parser::parse(stream, strideY) || ! Parser::parse(stream, strideX))
+    {
+        PT_LOG_ERROR << "Strides parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(strideY == 0 || strideX == 0)
+    {
+        PT_LOG_ERROR << "Invalid strides: " << strideY << ", " << strideX << std::endl;
+        return nullptr;
+    }
+
+    unsigned int samePadding = 0;
+
+    if(! Parser::parse(stream, samePadding))
+    {
+        PT_LOG_ERROR << "Padding parse failed" << std::endl;
+        return nullptr;
+    }
+
+    unsigned int dilationY = 0;
+    unsigned int dilationX = 0;
+
+    if(! Parser::parse(stream, dilationY) || ! Parser::parse(stream, dilationX))
+    {
+        PT_LOG_ERROR << "Dilation rate parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(dilationY == 0 || dilationX == 0)
+    {
+        PT_LOG_ERROR << "Invalid dilation rate: " << dilationY << ", " << dilationX << std::endl;
+        return nullptr;
+    }
+
+    return std::unique_ptr<DepthwiseConv2DLayer>(new DepthwiseConv2DLayer(std::move(*weights), depthMultiplier,
+                                                                          strideY, strideX, dilationY, dilationX,
+                                                                          samePadding));
+}
+
+DepthwiseConv2DLayer::DepthwiseConv2DLayer(Tensor&& weights, std::size_t depthMultiplier, std::size_t strideY,
+                                           std::size_t strideX, std::size_t dilationY, std::size_t dilationX,
+                                           bool samePadding) noexcept :
+    _weights(std::move(weights)),
+    _depthMultiplier(depthMultiplier),
+    _strideY(strideY),
+    _strideX(strideX),
+    _dilationY(dilationY),
+    _dilationX(dilationX),
+    _samePadding(samePadding)
+{
+}
+
+bool DepthwiseConv2DLayer::_geometry(const Tensor& in, Geometry& geometry) const
+{
+    const auto& iw = in.getDims();
+
+    if(iw.size() != 3)
+    {
+        PT_LOG_ERROR << "Input tensor dims count must be 3" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
+        return false;
+    }
+
+    const auto& ww = _weights.getDims();
+
+    if(iw[2] * _depthMultiplier != ww[2])
+    {
+        PT_LOG_ERROR << "Input tensor dims[2] times depth multiplier must be the same as weights dims[2]" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                            " (weights dims: " << VectorPrinter<std::size_t>{ ww } << ")" << std::endl;
+        return false;
+    }
+
+    // Dilated kernel size:
+    auto kernelY = (ww[0] - 1) * _dilationY + 1;
+    auto kernelX = (ww[1] - 1) * _dilationX + 1;
+    std::size_t outY;
+    std::size_t outX;
+    geometry.padTop = 0;
+    geometry.padLeft = 0;
+
+    if(_samePadding)
+    {
+        // Same as TensorFlow, extra padding goes to the bottom and right sides:
+        outY = (iw[0] + _strideY - 1) / _strideY;
+        outX = (iw[1] + _strideX - 1) / _strideX;
+
+        auto padY = (outY - 1) * _strideY + kernelY;
+        auto padX = (outX - 1) * _strideX + kernelX;
+        geometry.padTop = padY > iw[0] ? int(padY - iw[0]) / 2 : 0;
+        geometry.padLeft = padX > iw[1] ? int(padX - iw[1]) / 2 : 0;
+    }
+    else
+    {
+        if(iw[0] < kernelY || iw[1] < kernelX)
+        {
+            PT_LOG_ERROR << "Input tensor is smaller than the kernel" <<
+                                " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                                " (weights dims: " << VectorPrinter<std::size_t>{ ww } << ")" << std::endl;
+            return false;
+        }
+
+        outY = (iw[0] - kernelY) / _strideY + 1;
+        outX = (iw[1] - kernelX) / _strideX + 1;
+    }
+
+    geometry.outY = int(outY);
+    geometry.outX = int(outX);
+    return true;
+}
+
+int DepthwiseConv2DLayer::_channelStep() const noexcept
+{
+    auto channels = _weights.getDims()[2];
+
+    if(_depthMultiplier != 1)
+    {
+        return 1;
+    }
+
+    if(PT_LOOP_UNROLLING_ENABLE && channels % (Tensor::VectorSize * 2) == 0)
+    {
+        return Tensor::VectorSize * 2;
+    }
+
+    if(channels % Tensor::VectorSize == 0)
+    {
+        return Tensor::VectorSize;
+    }
+
+    return 1;
+}
+
+void DepthwiseConv2DLayer::_row(const Tensor& in, const Geometry& geometry, int y, int colBegin, int colEnd,
+                                int channelBegin, int channelEnd, Tensor::Type* out, int outInc) const noexcept
+{
+    const auto& iw = in.getDims();
+    const auto& ww = _weights.getDims();
+    auto dilationY = int(_dilationY);
+    auto kh = int(ww[0]);
+    auto inHeight = int(iw[0]);
+
+    DepthwiseRowParams params{ in.getData().data(), _weights.getData().data(),
+                               _biases.isValid() ? _biases.getData().data() : nullptr, inHeight, int(iw[1]),
+                               int(iw[2]), int(ww[2]), int(_depthMultiplier), kh, int(ww[1]), int(_strideX),
+                               dilationY, int(_dilationX), geometry.padLeft };
+
+    // Kernel rows outside of the input are zero padding, so they are skipped:
+    int iy = y * int(_strideY) - geometry.padTop;
+    int kyBegin = iy < 0 ? (dilationY - 1 - iy) / dilationY : 0;
+    int kyEnd = std::min(kh, (inHeight - iy + dilationY - 1) / dilationY);
+    auto channelStep = _channelStep();
+
+    if(channelStep == Tensor::VectorSize * 2)
+    {
+        vectorRow<2>(params, iy, kyBegin, kyEnd, colBegin, colEnd, channelBegin, channelEnd, out, outInc);
+    }
+    else if(channelStep == Tensor::VectorSize)
+    {
+        vectorRow<1>(params, iy, kyBegin, kyEnd, colBegin, colEnd, channelBegin, channelEnd, out, outInc);
+    }
+    else
+    {
+        scalarRow(params, iy, kyBegin, kyEnd, colBegin, colEnd, channelBegin, channelEnd, out, outInc);
+    }
+}
+
+}
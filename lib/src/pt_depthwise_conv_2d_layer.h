@@ -0,0 +1,65 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_DEPTHWISE_CONV_2D_LAYER_H
+#define PT_DEPTHWISE_CONV_2D_LAYER_H
+
+#include "pt_tensor.h"
+#include "pt_activation_layer.h"
+
+namespace pt
+{
+
+class DepthwiseConv2DLayer : public Layer
+{
+
+public:
+    static std::unique_ptr<DepthwiseConv2DLayer> create(std::istream& stream);
+
+    bool apply(LayerData& layerData) const final;
+
+protected:
+    friend class SeparableConv2DLayer;
+
+    struct Geometry
+    {
+        int outY;
+        int outX;
+        int padTop;
+        int padLeft;
+    };
+
+    // Weights are stored as (rows, cols, depth * depth multiplier), so output channels are contiguous:
+    Tensor _weights;
+    Tensor _biases;
+    std::unique_ptr<ActivationLayer> _activation;
+    std::size_t _depthMultiplier;
+    std::size_t _strideY;
+    std::size_t _strideX;
+    std::size_t _dilationY;
+    std::size_t _dilationX;
+    bool _samePadding;
+
+    // Parses weights, depth multiplier, strides, padding and dilation, without biases nor activation:
+    static std::unique_ptr<DepthwiseConv2DLayer> _create(std::istream& stream);
+
+    DepthwiseConv2DLayer(Tensor&& weights, std::size_t depthMultiplier, std::size_t strideY, std::size_t strideX,
+                         std::size_t dilationY, std::size_t dilationX, bool samePadding) noexcept;
+
+    bool _geometry(const Tensor& in, Geometry& geometry) const;
+
+    int _channelStep() const noexcept;
+
+    // Output pixels [colBegin, colEnd) of the given row, for output channels [channelBegin, channelEnd).
+    // Biases are added if present, but the activation is not applied:
+    void _row(const Tensor& in, const Geometry& geometry, int y, int colBegin, int colEnd, int channelBegin,
+              int channelEnd, Tensor::Type* out, int outInc) const noexcept;
+};
+
+}
+
+#endif
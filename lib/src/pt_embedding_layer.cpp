@@ -7,29 +7,367 @@
 
 #include "pt_embedding_layer.h"
 
+#include <array>
+#include <cstring>
+#include <algorithm>
+#include "pt_parser.h"
+#include "pt_gather.h"
+#include "pt_dispatcher.h"
 #include "pt_layer_data.h"
 #include "pt_logger.h"
 
 namespace pt
 {
 
+namespace
+{
+    // Min ids per task to split the gather across threads:
+    constexpr std::size_t minTaskIds = 64;
+
+    bool isValidId(Tensor::Type id, std::size_t rows) noexcept
+    {
+        return id >= 0 && id < Tensor::Type(rows);
+    }
+
+    bool isValidId(std::uint32_t id, std::size_t rows) noexcept
+    {
+        return id < rows;
+    }
+
+    // IEEE 754 half precision value to single precision:
+    float halfToFloat(std::uint16_t half) noexcept
+    {
+        std::uint32_t sign = std::uint32_t(half & 0x8000) << 16;
+        std::uint32_t exponent = (half >> 10) & 0x1f;
+        std::uint32_t mantissa = half & 0x3ff;
+        std::uint32_t bits;
+
+        if(exponent == 0x1f)
+        {
+            // Infinity or NaN:
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else if(exponent)
+        {
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        }
+        else
+        {
+            // Zero or subnormal:
+            float value = float(mantissa) * (1.0f / 16777216.0f);
+            return sign ? -value : value;
+        }
+
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    struct HalfRows
+    {
+        const std::uint16_t* begin;
+        std::size_t size;
+
+        PT_INLINE void prefetch(std::size_t row) const noexcept
+        {
+            prefetchRange(begin + row * size, size * sizeof(std::uint16_t));
+        }
+
+        PT_INLINE void copy(std::size_t row, Tensor::Type* out) const noexcept
+        {
+            auto rowIt = begin + row * size;
+
+            for(std::size_t index = 0; index != size; ++index)
+            {
+                out[index] = Tensor::Type(halfToFloat(rowIt[index]));
+            }
+        }
+    };
+
+    struct Int8Rows
+    {
+        const std::uint8_t* begin;
+        const float* scales;
+        const float* offsets;
+        std::size_t size;
+
+        PT_INLINE void prefetch(std::size_t row) const noexcept
+        {
+            prefetchRange(begin + row * size, size);
+        }
+
+        PT_INLINE void copy(std::size_t row, Tensor::Type* out) const noexcept
+        {
+            auto rowIt = begin + row * size;
+            auto scale = Tensor::Type(scales[row]);
+            auto offset = Tensor::Type(offsets[row]);
+
+            for(std::size_t index = 0; index != size; ++index)
+            {
+                out[index] = offset + Tensor::Type(rowIt[index]) * scale;
+            }
+        }
+    };
+
+    template<class Rows>
+    void decodeRows(const Rows& rows, std::size_t rowsCount, Tensor::Type* outBegin) noexcept
+    {
+        for(std::size_t row = 0; row != rowsCount; ++row)
+        {
+            rows.copy(row, outBegin + row * rows.size);
+        }
+    }
+
+    template<typename Id>
+    bool validateIds(const Id* ids, std::size_t count, std::size_t rows)
+    {
+        for(std::size_t index = 0; index != count; ++index)
+        {
+            if(! isValidId(ids[index], rows))
+            {
+                PT_LOG_ERROR << "Invalid input id: " << ids[index] << " (rows: " << rows << ")" << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Zero indices are masked only if there's any:
+    template<typename Id>
+    void maskIds(const Id* ids, std::size_t count, bool maskZero, std::vector<std::uint8_t>& mask)
+    {
+        mask.clear();
+
+        if(maskZero)
+        {
+            for(std::size_t index = 0; index != count; ++index)
+            {
+                if(std::size_t(ids[index]) == 0)
+                {
+                    mask.reserve(count);
+
+                    for(std::size_t maskIndex = 0; maskIndex != count; ++maskIndex)
+                    {
+                        mask.push_back(std::size_t(ids[maskIndex]) != 0);
+                    }
+
+                    break;
+                }
+            }
+        }
+    }
+
+    template<typename Id, class Rows>
+    bool embeddingImpl(const Id* ids, std::size_t count, const Rows& rows, std::size_t rowsCount, bool maskZero,
+                       LayerData& layerData)
+    {
+        struct Task
+        {
+            const Id* ids;
+            const Rows* rows;
+            LayerData* layerData;
+            std::size_t count;
+            std::size_t threads;
+            std::size_t taskId;
+
+            void operator()() noexcept
+            {
+                auto taskIds = count / threads;
+                auto taskBegin = taskIds * taskId;
+                std::size_t taskEnd;
+
+                if(taskId == threads - 1)
+                {
+                    taskEnd = count;
+                }
+                else
+                {
+                    taskEnd = taskBegin + taskIds;
+                }
+
+                gatherRows(ids + taskBegin, taskEnd - taskBegin, *rows,
+                           &*layerData->out.begin() + taskBegin * rows->size);
+            }
+        };
+
+        if(! validateIds(ids, count, rowsCount))
+        {
+            return false;
+        }
+
+        Tensor& out = layerData.out;
+        out.resize(count, rows.size);
+
+        // Long sequences are split across threads:
+        std::array<Task, PT_MAX_CPU_THREADS> tasks;
+        Dispatcher& dispatcher = layerData.dispatcher;
+        auto threads = std::min(dispatcher.threads(), std::max(count / minTaskIds, std::size_t(1)));
+
+        for(std::size_t taskId = 0; taskId != threads; ++taskId)
+        {
+            Task& task = tasks[taskId];
+            task = Task{ ids, &rows, &layerData, count, threads, taskId };
+            dispatcher.add([&task]{ task(); });
+        }
+
+        dispatcher.join();
+
+        maskIds(ids, count, maskZero, layerData.mask);
+        return true;
+    }
+
+    template<typename Id>
+    bool readIds(const Id* ids, std::size_t count, std::size_t rows, bool maskZero, LayerData& layerData,
+                 TokenVector& result)
+    {
+        if(! validateIds(ids, count, rows))
+        {
+            return false;
+        }
+
+        result.resize(count);
+
+        for(std::size_t index = 0; index != count; ++index)
+        {
+            result[index] = std::uint32_t(ids[index]);
+        }
+
+        maskIds(ids, count, maskZero, layerData.mask);
+        return true;
+    }
+}
+
 std::unique_ptr<EmbeddingLayer> EmbeddingLayer::create(std::istream& stream)
 {
-    auto weights = Tensor::create(2, stream);
+    unsigned int storage = 0;
+
+    if(! Parser::parse(stream, storage))
+    {
+        PT_LOG_ERROR << "Storage parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(storage != Float32 && storage != Float16 && storage != Int8)
+    {
+        PT_LOG_ERROR << "Invalid storage: " << storage << std::endl;
+        return nullptr;
+    }
+
+    Tensor weights;
+    unsigned int rows = 0;
+    unsigned int cols = 0;
+
+    if(storage == Float32)
+    {
+        auto weightsPtr = Tensor::create(2, stream);
+
+        if(! weightsPtr)
+        {
+            PT_LOG_ERROR << "Weights tensor parse failed" << std::endl;
+            return nullptr;
+        }
+
+        weights = std::move(*weightsPtr);
+        rows = unsigned(weights.getDims()[0]);
+        cols = unsigned(weights.getDims()[1]);
+    }
+    else
+    {
+        if(! Parser::parse(stream, rows) || ! Parser::parse(stream, cols))
+        {
+            PT_LOG_ERROR << "Weights dims parse failed" << std::endl;
+            return nullptr;
+        }
+
+        if(rows == 0 || cols == 0)
+        {
+            PT_LOG_ERROR << "Invalid weights dims: " << rows << ", " << cols << std::endl;
+            return nullptr;
+        }
+    }
+
+    std::size_t size = std::size_t(rows) * cols;
+    std::vector<std::uint16_t> halfWeights;
+    std::vector<std::uint8_t> codes;
+    std::vector<float> scales;
+    std::vector<float> offsets;
 
-    if(! weights)
+    if(storage == Float16)
     {
-        PT_LOG_ERROR << "Weights tensor parse failed" << std::endl;
+        halfWeights.resize(size);
+
+        if(! Parser::parse(stream, halfWeights.data(), size))
+        {
+            PT_LOG_ERROR << "Half weights parse failed" << std::endl;
+            return nullptr;
+        }
+    }
+    else if(storage == Int8)
+    {
+        scales.resize(rows);
+        offsets.resize(rows);
+        codes.resize(size);
+
+        if(! Parser::parse(stream, scales.data(), rows) || ! Parser::parse(stream, offsets.data(), rows))
+        {
+            PT_LOG_ERROR << "Scales and offsets parse failed" << std::endl;
+            return nullptr;
+        }
+
+        if(! Parser::parse(stream, codes.data(), size))
+        {
+            PT_LOG_ERROR << "Codes parse failed" << std::endl;
+            return nullptr;
+        }
+    }
+
+    unsigned int maskZero = 0;
+
+    if(! Parser::parse(stream, maskZero))
+    {
+        PT_LOG_ERROR << "Mask zero parse failed" << std::endl;
         return nullptr;
     }
 
-    return std::unique_ptr<EmbeddingLayer>(new EmbeddingLayer(std::move(*weights)));
+    std::unique_ptr<EmbeddingLayer> layer(new EmbeddingLayer(rows, cols, Storage(storage), maskZero));
+    layer->_weights = std::move(weights);
+    layer->_halfWeights = std::move(halfWeights);
+    layer->_codes = std::move(codes);
+    layer->_scales = std::move(scales);
+    layer->_offsets = std::move(offsets);
+    return layer;
 }
 
 bool EmbeddingLayer::apply(LayerData& layerData) const
 {
+    const TokenVector& tokens = layerData.tokens;
+
+    if(! tokens.empty())
+    {
+        return _apply(tokens.data(), tokens.size(), layerData);
+    }
+
+    if(! _validateInput(layerData))
+    {
+        return false;
+    }
+
     const Tensor& in = layerData.in;
-    const auto& iw = in.getDims();
+    return _apply(in.getData().data(), in.getSize(), layerData);
+}
+
+EmbeddingLayer::EmbeddingLayer(std::size_t rows, std::size_t cols, Storage storage, bool maskZero) noexcept :
+    _rows(rows),
+    _cols(cols),
+    _storage(storage),
+    _maskZero(maskZero)
+{
+}
+
+bool EmbeddingLayer::_validateInput(const LayerData& layerData) const
+{
+    const auto& iw = layerData.in.getDims();
 
     if(iw.size() != 1)
     {
@@ -38,26 +376,67 @@ bool EmbeddingLayer::apply(LayerData& layerData) const
         return false;
     }
 
-    Tensor& out = layerData.out;
-    out.resize(iw[0], _weights.getDims()[1]);
-
-    auto outIt = out.begin();
-    auto wBegin = _weights.begin();
-    auto inc = _weights.getDims()[1];
+    return true;
+}
 
-    for(auto inIt = in.begin(), inEnd = in.begin() + long(iw[0]); inIt != inEnd; ++inIt)
+template<typename Id>
+bool EmbeddingLayer::_apply(const Id* ids, std::size_t count, LayerData& layerData) const
+{
+    switch(_storage)
     {
-        auto wIt = wBegin + int(*inIt * inc);
-        std::memcpy(&*outIt, &*wIt, inc * sizeof(Tensor::Type));
-        outIt += long(inc);
+
+    case Float16:
+        return embeddingImpl(ids, count, HalfRows{ _halfWeights.data(), _cols }, _rows, _maskZero, layerData);
+
+    case Int8:
+        return embeddingImpl(ids, count, Int8Rows{ _codes.data(), _scales.data(), _offsets.data(), _cols }, _rows,
+                             _maskZero, layerData);
+
+    case Float32:
+        return embeddingImpl(ids, count, FloatRows{ _weights.getData().data(), _cols }, _rows, _maskZero,
+                             layerData);
     }
 
-    return true;
+    return false;
+}
+
+void EmbeddingLayer::_decode(Tensor& weights) const
+{
+    weights.resize(_rows, _cols);
+
+    switch(_storage)
+    {
+
+    case Float16:
+        decodeRows(HalfRows{ _halfWeights.data(), _cols }, _rows, &*weights.begin());
+        break;
+
+    case Int8:
+        decodeRows(Int8Rows{ _codes.data(), _scales.data(), _offsets.data(), _cols }, _rows, &*weights.begin());
+        break;
+
+    case Float32:
+        weights = _weights;
+        break;
+    }
 }
 
-EmbeddingLayer::EmbeddingLayer(Tensor&& weights) noexcept :
-    _weights(std::move(weights))
+bool EmbeddingLayer::_readIds(LayerData& layerData, TokenVector& ids) const
 {
+    const TokenVector& tokens = layerData.tokens;
+
+    if(! tokens.empty())
+    {
+        return readIds(tokens.data(), tokens.size(), _rows, _maskZero, layerData, ids);
+    }
+
+    if(! _validateInput(layerData))
+    {
+        return false;
+    }
+
+    const Tensor& in = layerData.in;
+    return readIds(in.getData().data(), in.getSize(), _rows, _maskZero, layerData, ids);
 }
 
 }
@@ -8,8 +8,11 @@
 #ifndef PT_EMBEDDING_LAYER_H
 #define PT_EMBEDDING_LAYER_H
 
+#include <vector>
+#include <cstdint>
 #include "pt_tensor.h"
 #include "pt_layer.h"
+#include "pt_token_vector.h"
 
 namespace pt
 {
@@ -23,9 +26,39 @@ public:
     bool apply(LayerData& layerData) const final;
 
 protected:
+    friend class EmbeddingLstmLayer;
+
+    enum Storage
+    {
+        Float32 = 0,
+        Float16 = 1,
+        Int8 = 2
+    };
+
+    // Weights are (rows, cols). Only the vector of the layer storage type is filled.
+    // 8-bit codes are decoded as offset + code * scale, with a scale and offset per row:
     Tensor _weights;
+    std::vector<std::uint16_t> _halfWeights;
+    std::vector<std::uint8_t> _codes;
+    std::vector<float> _scales;
+    std::vector<float> _offsets;
+    std::size_t _rows;
+    std::size_t _cols;
+    Storage _storage;
+    bool _maskZero;
+
+    EmbeddingLayer(std::size_t rows, std::size_t cols, Storage storage, bool maskZero) noexcept;
+
+    bool _validateInput(const LayerData& layerData) const;
+
+    template<typename Id>
+    bool _apply(const Id* ids, std::size_t count, LayerData& layerData) const;
+
+    // All rows decoded as floats:
+    void _decode(Tensor& weights) const;
 
-    explicit EmbeddingLayer(Tensor&& weights) noexcept;
+    // Validated input ids, read from the input tokens or tensor. The layer data mask is updated too:
+    bool _readIds(LayerData& layerData, TokenVector& ids) const;
 };
 
 }
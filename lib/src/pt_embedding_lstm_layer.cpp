@@ -0,0 +1,131 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_embedding_lstm_layer.h"
+
+#include <algorithm>
+#include "pt_config.h"
+#include "pt_gather.h"
+#include "pt_dispatcher.h"
+#include "pt_layer_data.h"
+
+namespace pt
+{
+
+namespace
+{
+    template<class LayerType>
+    std::unique_ptr<LayerType> castLayer(std::unique_ptr<Layer>& layer)
+    {
+        return std::unique_ptr<LayerType>(static_cast<LayerType*>(layer.release()));
+    }
+}
+
+void EmbeddingLstmLayer::fuse(std::vector<std::unique_ptr<Layer>>& layers)
+{
+    std::vector<std::unique_ptr<Layer>> fusedLayers;
+    std::unique_ptr<Dispatcher> dispatcher;
+    std::size_t layersCount = layers.size();
+    std::size_t index = 0;
+
+    while(index != layersCount)
+    {
+        auto embedding = dynamic_cast<const EmbeddingLayer*>(layers[index].get());
+        auto lstm = index + 1 != layersCount ? dynamic_cast<const LstmLayer*>(layers[index + 1].get()) : nullptr;
+
+        if(embedding && lstm)
+        {
+            const auto& ww = lstm->_w.getDims();
+            auto tableSize = embedding->_rows * ww[0] * sizeof(Tensor::Type);
+
+            if(embedding->_cols == ww[1] && tableSize <= std::size_t(PT_EMBEDDING_LSTM_MAX_TABLE_SIZE))
+            {
+                if(! dispatcher)
+                {
+                    dispatcher.reset(new Dispatcher());
+                }
+
+                // Quantized weights are decoded only while the table is computed:
+                const Tensor* weights = &embedding->_weights;
+                Tensor decodedWeights;
+
+                if(embedding->_storage != EmbeddingLayer::Float32)
+                {
+                    embedding->_decode(decodedWeights);
+                    weights = &decodedWeights;
+                }
+
+                Tensor table;
+                weights->dot(lstm->_w, table, *dispatcher);
+
+                fusedLayers.push_back(std::unique_ptr<Layer>(new EmbeddingLstmLayer(
+                                          castLayer<EmbeddingLayer>(layers[index]),
+                                          castLayer<LstmLayer>(layers[index + 1]), std::move(table))));
+                index += 2;
+                continue;
+            }
+        }
+
+        fusedLayers.push_back(std::move(layers[index]));
+        ++index;
+    }
+
+    layers = std::move(fusedLayers);
+}
+
+bool EmbeddingLstmLayer::apply(LayerData& layerData) const
+{
+    // LSTM prefix cache hashes LSTM input values, so original layers are run if it is enabled:
+    const Config& config = layerData.config;
+
+    if(! config.getLayerFusion() || (config.getLstmPrefixCache() && ! layerData.state))
+    {
+        if(! _embedding->apply(layerData))
+        {
+            return false;
+        }
+
+        layerData.in = std::move(layerData.out);
+        return _lstm->apply(layerData);
+    }
+
+    TokenVector ids;
+
+    if(! _embedding->_readIds(layerData, ids))
+    {
+        return false;
+    }
+
+    auto steps = ids.size();
+
+    // Input projections are gathered from the table, without masked steps:
+    if(! layerData.mask.empty())
+    {
+        ids.erase(std::remove(ids.begin(), ids.end(), 0u), ids.end());
+    }
+
+    Tensor xw;
+
+    if(! ids.empty())
+    {
+        auto rowSize = _table.getDims()[1];
+        xw.resize(ids.size(), rowSize);
+        gatherRows(ids.data(), ids.size(), FloatRows{ _table.getData().data(), rowSize }, &*xw.begin());
+    }
+
+    return _lstm->_apply(layerData, steps, &xw, std::ptrdiff_t(_lstm->_units * 4));
+}
+
+EmbeddingLstmLayer::EmbeddingLstmLayer(std::unique_ptr<EmbeddingLayer>&& embedding,
+                                       std::unique_ptr<LstmLayer>&& lstm, Tensor&& table) noexcept :
+    _embedding(std::move(embedding)),
+    _lstm(std::move(lstm)),
+    _table(std::move(table))
+{
+}
+
+}
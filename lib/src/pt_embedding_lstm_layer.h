@@ -0,0 +1,41 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_EMBEDDING_LSTM_LAYER_H
+#define PT_EMBEDDING_LSTM_LAYER_H
+
+#include <vector>
+#include "pt_embedding_layer.h"
+#include "pt_lstm_layer.h"
+
+namespace pt
+{
+
+class EmbeddingLstmLayer : public Layer
+{
+
+public:
+    // Replaces Embedding -> LSTM sequences with fused layers,
+    // if their projections table size is not greater than PT_EMBEDDING_LSTM_MAX_TABLE_SIZE:
+    static void fuse(std::vector<std::unique_ptr<Layer>>& layers);
+
+    bool apply(LayerData& layerData) const final;
+
+protected:
+    std::unique_ptr<EmbeddingLayer> _embedding;
+    std::unique_ptr<LstmLayer> _lstm;
+
+    // LSTM input projections of each embedding row, stored as (vocabulary size, 4 * units):
+    Tensor _table;
+
+    EmbeddingLstmLayer(std::unique_ptr<EmbeddingLayer>&& embedding, std::unique_ptr<LstmLayer>&& lstm,
+                       Tensor&& table) noexcept;
+};
+
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_EXP_H
+#define PT_EXP_H
+
+#include "pt_tensor.h"
+
+// Vector exp is only available for single precision floats:
+#define PT_VECTOR_EXP_ENABLE (! PT_DOUBLE_ENABLE)
+
+#if PT_VECTOR_EXP_ENABLE
+
+namespace pt
+{
+
+namespace detail
+{
+    PT_INLINE Tensor::Vector vectorConstant(Tensor::Type value) noexcept
+    {
+        Tensor::Vector result = makeVector(value);
+        return result;
+    }
+
+    // Cephes expf port (2 ulp max error):
+    PT_INLINE Tensor::Vector exp(const Tensor::Vector& value) noexcept
+    {
+        using IntVector = simdpp::int32<Tensor::VectorSize>;
+
+        Tensor::Vector x = simdpp::min(value, vectorConstant(88.3762626647949f));
+        x = simdpp::max(x, vectorConstant(-88.3762626647949f));
+
+        // exp(x) = 2^n * exp(g), with |g| <= 0.5 * ln(2):
+        Tensor::Vector n = simdpp::floor(simdpp::add(simdpp::mul(x, vectorConstant(1.44269504088896341f)),
+                                                     vectorConstant(0.5f)));
+        x = simdpp::sub(x, simdpp::mul(n, vectorConstant(0.693359375f)));
+        x = simdpp::sub(x, simdpp::mul(n, vectorConstant(-2.12194440e-4f)));
+
+        Tensor::Vector y = vectorConstant(1.9875691500e-4f);
+        y = simdpp::add(simdpp::mul(y, x), vectorConstant(1.3981999507e-3f));
+        y = simdpp::add(simdpp::mul(y, x), vectorConstant(8.3334519073e-3f));
+        y = simdpp::add(simdpp::mul(y, x), vectorConstant(4.1665795894e-2f));
+        y = simdpp::add(simdpp::mul(y, x), vectorConstant(1.6666665459e-1f));
+        y = simdpp::add(simdpp::mul(y, x), vectorConstant(5.0000001201e-1f));
+        y = simdpp::add(simdpp::add(simdpp::mul(y, simdpp::mul(x, x)), x), vectorConstant(1.0f));
+
+        // Build 2^n from its exponent bits:
+        IntVector exponent = simdpp::add(simdpp::to_int32(n), IntVector(simdpp::make_int(127)));
+        exponent = simdpp::shift_l<23>(exponent);
+        return simdpp::mul(y, simdpp::bit_cast<Tensor::Vector>(exponent));
+    }
+}
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_GATHER_H
+#define PT_GATHER_H
+
+#include <algorithm>
+#include "pt_tensor.h"
+
+namespace pt
+{
+
+PT_INLINE void prefetchRange(const void* begin, std::size_t bytes) noexcept
+{
+    auto it = static_cast<const char*>(begin);
+
+    for(std::size_t offset = 0; offset < bytes; offset += 64)
+    {
+        simdpp::prefetch_read(it + offset);
+    }
+}
+
+struct FloatRows
+{
+    const Tensor::Type* begin;
+    std::size_t size;
+
+    PT_INLINE void prefetch(std::size_t row) const noexcept
+    {
+        prefetchRange(begin + row * size, size * sizeof(Tensor::Type));
+    }
+
+    PT_INLINE void copy(std::size_t row, Tensor::Type* out) const noexcept
+    {
+        auto rowIt = begin + row * size;
+        std::copy(rowIt, rowIt + size, out);
+    }
+};
+
+// Copies (or decodes) the given rows, requesting the rows of the next ids in advance,
+// so their cache misses overlap with the copies:
+template<typename Id, class Rows>
+void gatherRows(const Id* ids, std::size_t count, const Rows& rows, Tensor::Type* outBegin) noexcept
+{
+    constexpr std::size_t prefetchRows = 4;
+
+    for(std::size_t index = 0; index != count; ++index)
+    {
+        if(index + prefetchRows < count)
+        {
+            rows.prefetch(std::size_t(ids[index + prefetchRows]));
+        }
+
+        rows.copy(std::size_t(ids[index]), outBegin + index * rows.size);
+    }
+}
+
+}
+
+#endif
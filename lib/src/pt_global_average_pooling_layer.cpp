@@ -0,0 +1,48 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_global_average_pooling_layer.h"
+
+#include "pt_layer_data.h"
+#include "pt_pooling.h"
+#include "pt_logger.h"
+
+namespace pt
+{
+
+std::unique_ptr<GlobalAveragePoolingLayer> GlobalAveragePoolingLayer::create(std::size_t dims, std::istream&)
+{
+    return std::unique_ptr<GlobalAveragePoolingLayer>(new GlobalAveragePoolingLayer(dims));
+}
+
+bool GlobalAveragePoolingLayer::apply(LayerData& layerData) const
+{
+    const Tensor& in = layerData.in;
+    const auto& iw = in.getDims();
+
+    if(iw.size() != _dims)
+    {
+        PT_LOG_ERROR << "Input tensor dims count must be " << _dims <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
+        return false;
+    }
+
+    if(in.getSize() == 0)
+    {
+        PT_LOG_ERROR << "Input tensor is empty" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
+        return false;
+    }
+
+    Tensor& out = layerData.out;
+    out.resize(iw.back());
+
+    globalPoolChannels<AveragePooling>(layerData);
+    return true;
+}
+
+}
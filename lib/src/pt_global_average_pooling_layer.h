@@ -0,0 +1,37 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_GLOBAL_AVERAGE_POOLING_LAYER_H
+#define PT_GLOBAL_AVERAGE_POOLING_LAYER_H
+
+#include "pt_layer.h"
+
+namespace pt
+{
+
+class GlobalAveragePoolingLayer : public Layer
+{
+
+public:
+    // Input tensors are (steps, channels) with 2 dims (GlobalAveragePooling1D)
+    // and (rows, cols, channels) with 3 dims (GlobalAveragePooling2D):
+    static std::unique_ptr<GlobalAveragePoolingLayer> create(std::size_t dims, std::istream& stream);
+
+    bool apply(LayerData& layerData) const final;
+
+protected:
+    std::size_t _dims;
+
+    explicit GlobalAveragePoolingLayer(std::size_t dims) noexcept :
+        _dims(dims)
+    {
+    }
+};
+
+}
+
+#endif
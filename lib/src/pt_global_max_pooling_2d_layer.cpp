@@ -8,76 +8,76 @@
 #include "pt_global_max_pooling_2d_layer.h"
 
 #include <array>
+#include <algorithm>
 #include "pt_parser.h"
 #include "pt_dispatcher.h"
 #include "pt_layer_data.h"
-#include "pt_max.h"
+#include "pt_pooling.h"
 
 namespace pt
 {
 
 namespace
 {
-    void maxImpl(LayerData& layerData)
+    // Min input pixels per task to split the spatial range across threads:
+    constexpr int minTaskPixels = 256;
+
+    // Pixel ranges are split across threads, and the partial maxima of each task are reduced at the end:
+    void pixelsImpl(LayerData& layerData)
     {
         struct Task
         {
             LayerData* layerData;
+            Tensor* partials;
             int threads;
             int taskId;
 
             void operator()() noexcept
             {
                 const Tensor& in = layerData->in;
-                Tensor& out = layerData->out;
 
                 const auto& iw = in.getDims();
-                auto its = out.getSize();
-                auto taskIts = its / std::size_t(threads);
-                auto taskBegin = taskIts * std::size_t(taskId);
-                std::size_t taskEnd;
+                auto channels = int(iw[2]);
+                auto pixels = int(iw[0] * iw[1]);
+                int taskPixels = pixels / threads;
+                int pixelBegin = taskPixels * taskId;
+                int pixelEnd;
 
                 if(taskId == threads - 1)
                 {
-                    taskEnd = its;
+                    pixelEnd = pixels;
                 }
                 else
                 {
-                    taskEnd = taskBegin + taskIts;
+                    pixelEnd = pixelBegin + taskPixels;
                 }
 
-                auto xl = iw[0];
-                auto yl = iw[1];
-
-                for(std::size_t z = taskBegin; z != taskEnd; ++z)
-                {
-                    Tensor::Type val = std::numeric_limits<Tensor::Type>::lowest();
-
-                    for(std::size_t x = 0; x != xl; ++x)
-                    {
-                        for(std::size_t y = 0; y != yl; ++y)
-                        {
-                            val = std::max(val, in(x, y, z));
-                        }
-                    }
-
-                    out(z) = val;
-                }
+                auto partialsBegin = const_cast<Tensor::Type*>(partials->getData().data());
+                PoolWindow window{ 1, pixelEnd - pixelBegin, 0, channels };
+                poolChannels<MaxPooling>(in.getData().data() + pixelBegin * channels, window,
+                                         partialsBegin + taskId * channels, channels);
             }
         };
 
+        const auto& iw = layerData.in.getDims();
+        auto channels = int(iw[2]);
         std::array<Task, PT_MAX_CPU_THREADS> tasks;
         Dispatcher& dispatcher = layerData.dispatcher;
         auto threads = int(dispatcher.threads());
+        Tensor partials(std::size_t(threads), iw[2]);
 
         for(int taskId = 0; taskId != threads; ++taskId)
         {
             Task& task = tasks[std::size_t(taskId)];
-            task = Task{ &layerData, threads, taskId };
+            task = Task{ &layerData, &partials, threads, taskId };
             dispatcher.add([&task]{ task(); });
         }
 
         dispatcher.join();
+
+        Tensor& out = layerData.out;
+        PoolWindow window{ 1, threads, 0, channels };
+        poolChannels<MaxPooling>(partials.getData().data(), window, &*out.begin(), channels);
     }
 }
 
@@ -98,9 +98,28 @@ bool GlobalMaxPooling2DLayer::apply(LayerData& layerData) const
         return false;
     }
 
+    if(in.getSize() == 0)
+    {
+        PT_LOG_ERROR << "Input tensor is empty" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
+        return false;
+    }
+
     Tensor& out = layerData.out;
     out.resize(iw[2]);
-    maxImpl(layerData);
+
+    // Large planes are split across threads, since channel blocks may be too few to feed all of them:
+    auto threads = int(layerData.dispatcher.threads());
+
+    if(threads > 1 && int(iw[0] * iw[1]) >= threads * minTaskPixels)
+    {
+        pixelsImpl(layerData);
+    }
+    else
+    {
+        globalPoolChannels<MaxPooling>(layerData);
+    }
+
     return true;
 }
 
@@ -0,0 +1,408 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_gru_layer.h"
+
+#include <algorithm>
+#include <functional>
+#include "pt_parser.h"
+#include "pt_layer_data.h"
+#include "pt_multiply_add.h"
+#include "pt_logger.h"
+
+namespace pt
+{
+
+struct GruLayer::TempData
+{
+    Tensor xw;
+    Tensor unmasked;
+    Tensor z;
+    Tensor r;
+    Tensor h;
+    Tensor rh;
+    Tensor ht;
+
+    explicit TempData(std::size_t units) :
+        z(units),
+        r(units),
+        h(units),
+        rh(units),
+        ht(units)
+    {
+    }
+};
+
+std::unique_ptr<GruLayer> GruLayer::create(std::istream& stream)
+{
+    auto w = Tensor::create(2, stream);
+
+    if(! w)
+    {
+        PT_LOG_ERROR << "w tensor parse failed" << std::endl;
+        return nullptr;
+    }
+
+    auto u = Tensor::create(2, stream);
+
+    if(! u)
+    {
+        PT_LOG_ERROR << "u tensor parse failed" << std::endl;
+        return nullptr;
+    }
+
+    auto b = Tensor::create(2, stream);
+
+    if(! b)
+    {
+        PT_LOG_ERROR << "b tensor parse failed" << std::endl;
+        return nullptr;
+    }
+
+    auto innerActivation = ActivationLayer::create(stream);
+
+    if(! innerActivation)
+    {
+        PT_LOG_ERROR << "Activation layer parse failed" << std::endl;
+        return nullptr;
+    }
+
+    auto activation = ActivationLayer::create(stream);
+
+    if(! activation)
+    {
+        PT_LOG_ERROR << "Activation layer parse failed" << std::endl;
+        return nullptr;
+    }
+
+    unsigned int returnSequences = 0;
+
+    if(! Parser::parse(stream, returnSequences))
+    {
+        PT_LOG_ERROR << "Return sequences parse failed" << std::endl;
+        return nullptr;
+    }
+
+    unsigned int resetAfter = 0;
+
+    if(! Parser::parse(stream, resetAfter))
+    {
+        PT_LOG_ERROR << "Reset after parse failed" << std::endl;
+        return nullptr;
+    }
+
+    const auto& uw = u->getDims();
+    auto units = uw[1];
+
+    if(uw[0] != units * 3)
+    {
+        PT_LOG_ERROR << "Invalid u tensor dims" <<
+                            " (u dims: " << VectorPrinter<std::size_t>{ uw } << ")" << std::endl;
+        return nullptr;
+    }
+
+    if(w->getDims()[0] != uw[0])
+    {
+        PT_LOG_ERROR << "Invalid w tensor dims" <<
+                            " (w dims: " << VectorPrinter<std::size_t>{ w->getDims() } << ")" << std::endl;
+        return nullptr;
+    }
+
+    const auto& bw = b->getDims();
+
+    if(bw[0] != 2 || bw[1] != uw[0])
+    {
+        PT_LOG_ERROR << "Invalid b tensor dims" <<
+                            " (b dims: " << VectorPrinter<std::size_t>{ bw } << ")" << std::endl;
+        return nullptr;
+    }
+
+    // Recurrent biases are added to the input ones, except the reset-gated one:
+    Tensor inputB(uw[0]);
+    Tensor recurrentB(units);
+    auto bIt = b->begin();
+    auto recurrentBIt = bIt + long(uw[0]);
+    auto foldedSize = long(resetAfter ? units * 2 : units * 3);
+    std::transform(bIt, bIt + foldedSize, recurrentBIt, inputB.begin(), std::plus<Tensor::Type>());
+
+    if(resetAfter)
+    {
+        std::copy(bIt + foldedSize, recurrentBIt, inputB.begin() + foldedSize);
+        std::copy(recurrentBIt + foldedSize, b->end(), recurrentB.begin());
+    }
+    else
+    {
+        recurrentB.fill(0);
+    }
+
+    return std::unique_ptr<GruLayer>(new GruLayer(std::move(*w), std::move(*u), std::move(inputB),
+                                                  std::move(recurrentB), std::move(innerActivation),
+                                                  std::move(activation), returnSequences, resetAfter));
+}
+
+GruLayer::~GruLayer() noexcept
+{
+}
+
+bool GruLayer::apply(LayerData& layerData) const
+{
+    Tensor& in = layerData.in;
+
+    if(in.getDims().size() == 1)
+    {
+        // Single step:
+        in.resize(1, in.getDims()[0]);
+    }
+
+    const auto& iw = in.getDims();
+
+    if(iw.size() != 2)
+    {
+        PT_LOG_ERROR << "Input tensor dims count must be 1 or 2" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
+        return false;
+    }
+
+    const auto& ww = _w.getDims();
+
+    if(iw[1] != ww[1])
+    {
+        PT_LOG_ERROR << "Input tensor dims[1] must be the same as w dims[1]" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                            " (w dims: " << VectorPrinter<std::size_t>{ ww } << ")" << std::endl;
+        return false;
+    }
+
+    auto steps = iw[0];
+    const std::uint8_t* mask = nullptr;
+
+    if(! layerData.mask.empty())
+    {
+        if(layerData.mask.size() != steps)
+        {
+            PT_LOG_ERROR << "Mask size must be the same as input tensor dims[0]" <<
+                                " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                                " (mask size: " << layerData.mask.size() << ")" << std::endl;
+            return false;
+        }
+
+        mask = layerData.mask.data();
+    }
+
+    std::vector<Tensor>* state = layerData.state;
+
+    if(state)
+    {
+        if(state->empty())
+        {
+            state->emplace_back(_units);
+        }
+        else if(state->size() != 1 || (*state)[0].getSize() != _units)
+        {
+            PT_LOG_ERROR << "Invalid RNN state" << std::endl;
+            return false;
+        }
+    }
+
+    auto tempData = _tempDataPool.acquire(_units);
+
+    if(state)
+    {
+        std::copy((*state)[0].begin(), (*state)[0].end(), tempData->ht.begin());
+    }
+    else
+    {
+        tempData->ht.fill(0);
+    }
+
+    Tensor& out = layerData.out;
+    Tensor::Type* outPtr = nullptr;
+    std::size_t outInc = 0;
+
+    if(_returnSequences)
+    {
+        out.resize(steps, _units);
+        outPtr = &*out.begin();
+        outInc = _units;
+    }
+
+    // Masked steps are not projected:
+    const Tensor* projectedIn = &in;
+    auto projectedSteps = steps;
+
+    if(mask)
+    {
+        projectedSteps = std::size_t(std::count(mask, mask + steps, std::uint8_t(1)));
+
+        if(projectedSteps && projectedSteps != steps)
+        {
+            Tensor& unmasked = tempData->unmasked;
+            unmasked.resize(projectedSteps, iw[1]);
+
+            auto unmaskedIt = unmasked.begin();
+            auto rowSize = long(iw[1]);
+
+            for(std::size_t step = 0; step != steps; ++step)
+            {
+                if(mask[step])
+                {
+                    auto rowIt = in.begin() + long(step) * rowSize;
+                    unmaskedIt = std::copy(rowIt, rowIt + rowSize, unmaskedIt);
+                }
+            }
+
+            projectedIn = &unmasked;
+        }
+    }
+
+    // Input projections don't depend on the recurrent state, so they are computed for all steps at once:
+    if(projectedSteps)
+    {
+        projectedIn->dot(_w, tempData->xw, layerData.dispatcher);
+    }
+
+    _runSteps(tempData->xw.getData().data(), steps, mask, *tempData, outPtr, outInc);
+
+    if(state)
+    {
+        std::copy(tempData->ht.begin(), tempData->ht.end(), (*state)[0].begin());
+    }
+
+    if(_returnSequences)
+    {
+        out.eraseDummyDims();
+    }
+    else
+    {
+        out.resize(_units);
+        std::copy(tempData->ht.begin(), tempData->ht.end(), out.begin());
+        layerData.mask.clear();
+    }
+
+    _tempDataPool.release(std::move(tempData));
+    return true;
+}
+
+GruLayer::GruLayer(Tensor&& w, Tensor&& u, Tensor&& b, Tensor&& recurrentB,
+                   std::unique_ptr<ActivationLayer>&& innerActivation, std::unique_ptr<ActivationLayer>&& activation,
+                   bool returnSequences, bool resetAfter) noexcept :
+    _w(std::move(w)),
+    _u(std::move(u)),
+    _b(std::move(b)),
+    _recurrentB(std::move(recurrentB)),
+    _innerActivation(std::move(innerActivation)),
+    _activation(std::move(activation)),
+    _units(_recurrentB.getSize()),
+    _returnSequences(returnSequences),
+    _resetAfter(resetAfter)
+{
+}
+
+void GruLayer::_runSteps(const Tensor::Type* xw, std::size_t steps, const std::uint8_t* mask,
+                         TempData& tempData, Tensor::Type* outPtr, std::size_t outInc) const
+{
+    if(PT_LOOP_UNROLLING_ENABLE && _units % (Tensor::VectorSize * 2) == 0)
+    {
+        _steps<Vector2MultiplyAdd>(xw, steps, mask, tempData, outPtr, outInc);
+    }
+    else if(_units % Tensor::VectorSize == 0)
+    {
+        _steps<VectorMultiplyAdd>(xw, steps, mask, tempData, outPtr, outInc);
+    }
+    else
+    {
+        _steps<ScalarMultiplyAdd>(xw, steps, mask, tempData, outPtr, outInc);
+    }
+}
+
+template<class MultiplyAddType>
+void GruLayer::_steps(const Tensor::Type* xw, std::size_t steps, const std::uint8_t* mask, TempData& tempData,
+                      Tensor::Type* outPtr, std::size_t outInc) const
+{
+    auto units = int(_units);
+    auto xwIt = xw;
+    auto uBegin = _u.getData().data();
+    auto uhBegin = uBegin + units * units * 2;
+    auto bBegin = _b.getData().data();
+    auto rbBegin = _recurrentB.getData().data();
+    auto z = &*tempData.z.begin();
+    auto r = &*tempData.r.begin();
+    auto h = &*tempData.h.begin();
+    auto rh = &*tempData.rh.begin();
+    auto ht = &*tempData.ht.begin();
+    MultiplyAddType multiplyAdd;
+
+    for(std::size_t s = 0; s != steps; ++s)
+    {
+        if(mask && ! mask[s])
+        {
+            // Masked steps keep the previous state and output:
+            if(outPtr)
+            {
+                std::copy(ht, ht + units, outPtr);
+                outPtr += outInc;
+            }
+
+            continue;
+        }
+
+        auto uIt = uBegin;
+        auto bIt = bBegin;
+
+        for(Tensor::Type* gate : { z, r })
+        {
+            for(auto gateIt = gate, gateEnd = gate + units; gateIt != gateEnd; ++gateIt)
+            {
+                *gateIt = *xwIt + *bIt + multiplyAdd(uIt, ht, units);
+                ++xwIt;
+                ++bIt;
+                uIt += units;
+            }
+        }
+
+        _innerActivation->apply(tempData.z);
+        _innerActivation->apply(tempData.r);
+
+        if(_resetAfter)
+        {
+            // Reset gate is applied after the recurrent projection:
+            for(int index = 0; index != units; ++index)
+            {
+                rh[index] = multiplyAdd(uhBegin + index * units, ht, units) + rbBegin[index];
+                h[index] = xwIt[index] + bIt[index] + r[index] * rh[index];
+            }
+        }
+        else
+        {
+            for(int index = 0; index != units; ++index)
+            {
+                rh[index] = r[index] * ht[index];
+            }
+
+            for(int index = 0; index != units; ++index)
+            {
+                h[index] = xwIt[index] + bIt[index] + multiplyAdd(uhBegin + index * units, rh, units);
+            }
+        }
+
+        xwIt += units;
+        _activation->apply(tempData.h);
+
+        for(int index = 0; index != units; ++index)
+        {
+            ht[index] = z[index] * ht[index] + (1 - z[index]) * h[index];
+        }
+
+        if(outPtr)
+        {
+            std::copy(ht, ht + units, outPtr);
+            outPtr += outInc;
+        }
+    }
+}
+
+}
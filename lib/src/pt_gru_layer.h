@@ -0,0 +1,60 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_GRU_LAYER_H
+#define PT_GRU_LAYER_H
+
+#include <vector>
+#include <cstdint>
+#include "pt_tensor.h"
+#include "pt_activation_layer.h"
+#include "pt_temp_data_pool.h"
+
+namespace pt
+{
+
+class GruLayer : public Layer
+{
+
+public:
+    static std::unique_ptr<GruLayer> create(std::istream& stream);
+
+    ~GruLayer() noexcept;
+
+    bool apply(LayerData& layerData) const final;
+
+protected:
+    struct TempData;
+
+    // Gate weights are fused in z, r, h order:
+    Tensor _w;
+    Tensor _u;
+    Tensor _b;
+    Tensor _recurrentB;
+    std::unique_ptr<ActivationLayer> _innerActivation;
+    std::unique_ptr<ActivationLayer> _activation;
+    std::size_t _units;
+    bool _returnSequences;
+    bool _resetAfter;
+
+    mutable TempDataPool<TempData> _tempDataPool;
+
+    GruLayer(Tensor&& w, Tensor&& u, Tensor&& b, Tensor&& recurrentB,
+             std::unique_ptr<ActivationLayer>&& innerActivation, std::unique_ptr<ActivationLayer>&& activation,
+             bool returnSequences, bool resetAfter) noexcept;
+
+    void _runSteps(const Tensor::Type* xw, std::size_t steps, const std::uint8_t* mask, TempData& tempData,
+                   Tensor::Type* outPtr, std::size_t outInc) const;
+
+    template<class MultiplyAddType>
+    void _steps(const Tensor::Type* xw, std::size_t steps, const std::uint8_t* mask, TempData& tempData,
+                Tensor::Type* outPtr, std::size_t outInc) const;
+};
+
+}
+
+#endif
@@ -11,18 +11,25 @@
 #include "pt_dense_layer.h"
 #include "pt_conv_1d_layer.h"
 #include "pt_conv_2d_layer.h"
+#include "pt_depthwise_conv_2d_layer.h"
+#include "pt_separable_conv_2d_layer.h"
 #include "pt_locally_connected_1d_layer.h"
 #include "pt_flatten_layer.h"
 #include "pt_elu_layer.h"
 #include "pt_activation_layer.h"
 #include "pt_max_pooling_2d_layer.h"
+#include "pt_average_pooling_2d_layer.h"
 #include "pt_lstm_layer.h"
+#include "pt_gru_layer.h"
+#include "pt_bidirectional_layer.h"
 #include "pt_embedding_layer.h"
 #include "pt_batch_normalization_layer.h"
 #include "pt_leaky_relu_layer.h"
 #include "pt_global_max_pooling_2d_layer.h"
+#include "pt_global_average_pooling_layer.h"
 #include "pt_repeat_vector_layer.h"
 #include "pt_input_layer.h"
+#include "pt_masking_layer.h"
 
 namespace pt
 {
@@ -45,7 +52,15 @@ namespace
         LeakyRelu = 13,
         GlobalMaxPooling2D = 14,
         Input = 15,
-        RepeatVector = 16
+        RepeatVector = 16,
+        Masking = 17,
+        Gru = 18,
+        Bidirectional = 19,
+        DepthwiseConv2D = 20,
+        SeparableConv2D = 21,
+        AveragePooling2D = 22,
+        GlobalAveragePooling2D = 23,
+        GlobalAveragePooling1D = 24
     };
 }
 
@@ -124,6 +139,38 @@ std::unique_ptr<Layer> Layer::create(std::istream& stream)
         layer = RepeatVectorLayer::create(stream);
         break;
 
+    case Masking:
+        layer = MaskingLayer::create(stream);
+        break;
+
+    case Gru:
+        layer = GruLayer::create(stream);
+        break;
+
+    case Bidirectional:
+        layer = BidirectionalLayer::create(stream);
+        break;
+
+    case DepthwiseConv2D:
+        layer = DepthwiseConv2DLayer::create(stream);
+        break;
+
+    case SeparableConv2D:
+        layer = SeparableConv2DLayer::create(stream);
+        break;
+
+    case AveragePooling2D:
+        layer = AveragePooling2DLayer::create(stream);
+        break;
+
+    case GlobalAveragePooling2D:
+        layer = GlobalAveragePoolingLayer::create(3, stream);
+        break;
+
+    case GlobalAveragePooling1D:
+        layer = GlobalAveragePoolingLayer::create(2, stream);
+        break;
+
     default:
         PT_LOG_ERROR << "Unknown layer ID: " << layerID << std::endl;
     }
@@ -19,20 +19,29 @@ namespace pt
 template<typename T>
 struct VectorPrinter
 {
-    const std::vector<T>& vector;
+    const T* data;
+    std::size_t size;
+
+    // Any container with contiguous values (std::vector, DimsVector):
+    template<class VectorType>
+    VectorPrinter(const VectorType& vector) noexcept :
+        data(vector.data()),
+        size(vector.size())
+    {
+    }
 
     friend std::ostream& operator<<(std::ostream& stream, const VectorPrinter& vectorPrinter)
     {
         stream << '[';
 
-        for(std::size_t i = 0, l = vectorPrinter.vector.size(); i < l; ++i)
+        for(std::size_t i = 0, l = vectorPrinter.size; i < l; ++i)
         {
             if(i)
             {
                 stream << ", ";
             }
 
-            stream << vectorPrinter.vector[i];
+            stream << vectorPrinter.data[i];
         }
 
         stream << ']';
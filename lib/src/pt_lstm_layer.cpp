@@ -7,43 +7,39 @@
 
 #include "pt_lstm_layer.h"
 
+#include <atomic>
+#include <cstring>
+#include <algorithm>
 #include "pt_parser.h"
-#include "pt_dispatcher.h"
+#include "pt_config.h"
 #include "pt_layer_data.h"
+#include "pt_multiply_add.h"
+#include "pt_lstm_prefix_cache.h"
 #include "pt_logger.h"
 
 namespace pt
 {
 
-struct LstmLayer::TempData
+namespace
 {
-    Dispatcher dummyDispatcher;
-    Tensor ht;
-    Tensor ct;
-    Tensor last;
-    Tensor inRow;
-    Tensor i;
-    Tensor f;
-    Tensor c;
-    Tensor o;
-    Tensor tmp1;
-    Tensor tmp2;
+    // Prefix cache entries are owned by layer ids instead of addresses,
+    // so a new layer never reuses the entries of a destroyed one:
+    std::atomic<std::uint64_t> nextLayerId(0);
 
-    explicit TempData(std::size_t outDim) :
-        dummyDispatcher(1)
+    Tensor fuseGates(const Tensor& i, const Tensor& f, const Tensor& c, const Tensor& o)
     {
-        ht.resize(1, outDim);
-        ct.resize(1, outDim);
-    }
+        const auto& dims = i.getDims();
+        Tensor fused(dims[0] * 4, dims[1]);
+        auto fusedIt = fused.begin();
 
-    void dot(const Tensor& w, const Tensor& b, const Tensor& u, Tensor& out)
-    {
-        inRow.dot(w, tmp1, dummyDispatcher);
-        tmp1.add(b, tmp2, dummyDispatcher);
-        ht.dot(u, tmp1, dummyDispatcher);
-        tmp2.add(tmp1, out, dummyDispatcher);
+        for(const Tensor* gate : { &i, &f, &c, &o })
+        {
+            fusedIt = std::copy(gate->begin(), gate->end(), fusedIt);
+        }
+
+        return fused;
     }
-};
+}
 
 std::unique_ptr<LstmLayer> LstmLayer::create(std::istream& stream)
 {
@@ -167,111 +163,476 @@ std::unique_ptr<LstmLayer> LstmLayer::create(std::istream& stream)
         return nullptr;
     }
 
-    return std::unique_ptr<LstmLayer>(new LstmLayer(std::move(*wi), std::move(*ui), std::move(*bi),
-                                                    std::move(*wf), std::move(*uf), std::move(*bf),
-                                                    std::move(*wc), std::move(*uc), std::move(*bc),
-                                                    std::move(*wo), std::move(*uo), std::move(*bo),
+    auto units = bo->getDims()[1];
+
+    for(const Tensor* tensor : { wi.get(), wf.get(), wc.get(), wo.get() })
+    {
+        if(tensor->getDims()[0] != units || tensor->getDims()[1] != wi->getDims()[1])
+        {
+            PT_LOG_ERROR << "Invalid w tensor dims" <<
+                                " (w dims: " << VectorPrinter<std::size_t>{ tensor->getDims() } << ")" << std::endl;
+            return nullptr;
+        }
+    }
+
+    for(const Tensor* tensor : { ui.get(), uf.get(), uc.get(), uo.get() })
+    {
+        if(tensor->getDims()[0] != units || tensor->getDims()[1] != units)
+        {
+            PT_LOG_ERROR << "Invalid u tensor dims" <<
+                                " (u dims: " << VectorPrinter<std::size_t>{ tensor->getDims() } << ")" << std::endl;
+            return nullptr;
+        }
+    }
+
+    for(const Tensor* tensor : { bi.get(), bf.get(), bc.get() })
+    {
+        if(tensor->getDims() != bo->getDims())
+        {
+            PT_LOG_ERROR << "Invalid b tensor dims" <<
+                                " (b dims: " << VectorPrinter<std::size_t>{ tensor->getDims() } << ")" << std::endl;
+            return nullptr;
+        }
+    }
+
+    auto w = fuseGates(*wi, *wf, *wc, *wo);
+    auto u = fuseGates(*ui, *uf, *uc, *uo);
+    auto b = fuseGates(*bi, *bf, *bc, *bo);
+    b.flatten();
+
+    return std::unique_ptr<LstmLayer>(new LstmLayer(std::move(w), std::move(u), std::move(b),
                                                     std::move(innerActivation),
                                                     std::move(activation), returnSequences));
 }
 
+LstmLayer::~LstmLayer() noexcept
+{
+}
+
 bool LstmLayer::apply(LayerData& layerData) const
 {
-    const Tensor& in = layerData.in;
+    Tensor& in = layerData.in;
+
+    if(in.getDims().size() == 1)
+    {
+        // Single step:
+        in.resize(1, in.getDims()[0]);
+    }
+
     const auto& iw = in.getDims();
 
     if(iw.size() != 2)
     {
-        PT_LOG_ERROR << "Input tensor dims count must be 2" <<
+        PT_LOG_ERROR << "Input tensor dims count must be 1 or 2" <<
                             " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
         return false;
     }
 
-    auto outDim = _bo.getDims()[1];
-    auto steps = iw[0];
+    const auto& ww = _w.getDims();
+
+    if(iw[1] != ww[1])
+    {
+        PT_LOG_ERROR << "Input tensor dims[1] must be the same as w dims[1]" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                            " (w dims: " << VectorPrinter<std::size_t>{ ww } << ")" << std::endl;
+        return false;
+    }
+
+    return _apply(layerData, iw[0], nullptr, std::ptrdiff_t(_units * 4));
+}
+
+LstmLayer::LstmLayer(Tensor&& w, Tensor&& u, Tensor&& b, std::unique_ptr<ActivationLayer>&& innerActivation,
+                     std::unique_ptr<ActivationLayer>&& activation, bool returnSequences) noexcept :
+    _w(std::move(w)),
+    _u(std::move(u)),
+    _b(std::move(b)),
+    _innerActivation(std::move(innerActivation)),
+    _activation(std::move(activation)),
+    _units(_b.getSize() / 4),
+    _id(nextLayerId++),
+    _returnSequences(returnSequences)
+{
+}
+
+bool LstmLayer::_apply(LayerData& layerData, std::size_t steps, const Tensor* xw, std::ptrdiff_t xwInc) const
+{
+    const std::uint8_t* mask = nullptr;
+
+    if(! layerData.mask.empty())
+    {
+        if(layerData.mask.size() != steps)
+        {
+            PT_LOG_ERROR << "Mask size must be the same as input steps" <<
+                                " (input steps: " << steps << ")" <<
+                                " (mask size: " << layerData.mask.size() << ")" << std::endl;
+            return false;
+        }
+
+        mask = layerData.mask.data();
+    }
+
+    std::vector<Tensor>* state = layerData.state;
+
+    if(state)
+    {
+        if(state->empty())
+        {
+            state->emplace_back(_units);
+            state->emplace_back(_units);
+        }
+        else if(state->size() != 2 || (*state)[0].getSize() != _units || (*state)[1].getSize() != _units)
+        {
+            PT_LOG_ERROR << "Invalid RNN state" << std::endl;
+            return false;
+        }
+    }
+
+    auto tempData = _tempDataPool.acquire(_units);
+
+    if(state)
+    {
+        std::copy((*state)[0].begin(), (*state)[0].end(), tempData->ht.begin());
+        std::copy((*state)[1].begin(), (*state)[1].end(), tempData->ct.begin());
+    }
+    else
+    {
+        tempData->ht.fill(0);
+        tempData->ct.fill(0);
+    }
 
-    TempData tempData(outDim);
     Tensor& out = layerData.out;
+    Tensor::Type* outPtr = nullptr;
+    std::size_t outInc = 0;
 
     if(_returnSequences)
     {
-        out.resize(steps, outDim);
+        out.resize(steps, _units);
+        outPtr = &*out.begin();
+        outInc = _units;
+    }
 
-        auto outIt = out.begin();
+    // Given input projections are not hashed, so they are not cached:
+    const Tensor& in = layerData.in;
+    LstmPrefixCache* prefixCache = state || xw ? nullptr : layerData.config.getLstmPrefixCache().get();
+    std::size_t firstStep = 0;
 
-        for(std::size_t s = 0; s != steps; ++s)
+    if(prefixCache)
+    {
+        firstStep = _loadPrefix(*prefixCache, in, mask, *tempData, outPtr);
+    }
+
+    if(firstStep != steps)
+    {
+        if(! xw)
         {
-            in.select(s, tempData.inRow);
-            _step(tempData, tempData.last);
-            std::copy(tempData.last.begin(), tempData.last.end(), outIt);
-            outIt += tempData.last.end() - tempData.last.begin();
+            _project(in, mask, firstStep, *tempData, layerData.dispatcher);
+            xw = &tempData->xw;
         }
+
+        const Tensor::Type* xwPtr = xw->getData().data();
+        outPtr += firstStep * outInc;
+
+        if(mask)
+        {
+            mask += firstStep;
+        }
+
+        if(prefixCache)
+        {
+            auto interval = prefixCache->getInterval();
+
+            for(std::size_t step = firstStep; step != steps; )
+            {
+                auto chunkEnd = std::min((step / interval + 1) * interval, steps);
+                auto chunkSteps = chunkEnd - step;
+                xwPtr = _runSteps(xwPtr, xwInc, chunkSteps, mask, *tempData, outPtr, outInc);
+                outPtr += chunkSteps * outInc;
+                step = chunkEnd;
+
+                if(mask)
+                {
+                    mask += chunkSteps;
+                }
+
+                if(step % interval == 0)
+                {
+                    _storePrefix(*prefixCache, step, *tempData, outPtr - interval * outInc);
+                }
+            }
+        }
+        else
+        {
+            _runSteps(xwPtr, xwInc, steps - firstStep, mask, *tempData, outPtr, outInc);
+        }
+    }
+
+    if(state)
+    {
+        std::copy(tempData->ht.begin(), tempData->ht.end(), (*state)[0].begin());
+        std::copy(tempData->ct.begin(), tempData->ct.end(), (*state)[1].begin());
+    }
+
+    if(_returnSequences)
+    {
+        out.eraseDummyDims();
     }
     else
     {
-        for(std::size_t s = 0; s != steps; ++s)
+        out.resize(_units);
+        std::copy(tempData->ht.begin(), tempData->ht.end(), out.begin());
+    }
+
+    if(! _returnSequences)
+    {
+        layerData.mask.clear();
+    }
+
+    _tempDataPool.release(std::move(tempData));
+    return true;
+}
+
+void LstmLayer::_project(const Tensor& in, const std::uint8_t* mask, std::size_t firstStep, TempData& tempData,
+                         Dispatcher& dispatcher) const
+{
+    // Cached and masked steps are not projected:
+    const auto& iw = in.getDims();
+    auto steps = iw[0];
+    const Tensor* projectedIn = &in;
+    auto projectedSteps = steps - firstStep;
+
+    if(mask)
+    {
+        projectedSteps = std::size_t(std::count(mask + firstStep, mask + steps, std::uint8_t(1)));
+    }
+
+    if(projectedSteps && projectedSteps != steps)
+    {
+        Tensor& suffix = tempData.suffix;
+        suffix.resize(projectedSteps, iw[1]);
+
+        auto suffixIt = suffix.begin();
+        auto rowSize = long(iw[1]);
+
+        for(auto step = firstStep; step != steps; ++step)
         {
-            in.select(s, tempData.inRow);
-            _step(tempData, out);
+            if(! mask || mask[step])
+            {
+                auto rowIt = in.begin() + long(step) * rowSize;
+                suffixIt = std::copy(rowIt, rowIt + rowSize, suffixIt);
+            }
         }
+
+        projectedIn = &suffix;
     }
 
-    out.eraseDummyDims();
-    return true;
+    // Input projections don't depend on the recurrent state, so they are computed for all steps at once:
+    if(projectedSteps)
+    {
+        projectedIn->dot(_w, tempData.xw, dispatcher);
+    }
 }
 
-LstmLayer::LstmLayer(Tensor&& wi, Tensor&& ui, Tensor&& bi, Tensor&& wf, Tensor&& uf, Tensor&& bf,
-                     Tensor&& wc, Tensor&& uc, Tensor&& bc, Tensor&& wo, Tensor&& uo, Tensor&& bo,
-                     std::unique_ptr<ActivationLayer>&& innerActivation,
-                     std::unique_ptr<ActivationLayer>&& activation, bool returnSequences) noexcept :
-    _wi(std::move(wi)),
-    _ui(std::move(ui)),
-    _bi(std::move(bi)),
-    _wf(std::move(wf)),
-    _uf(std::move(uf)),
-    _bf(std::move(bf)),
-    _wc(std::move(wc)),
-    _uc(std::move(uc)),
-    _bc(std::move(bc)),
-    _wo(std::move(wo)),
-    _uo(std::move(uo)),
-    _bo(std::move(bo)),
-    _innerActivation(std::move(innerActivation)),
-    _activation(std::move(activation)),
-    _returnSequences(returnSequences)
+std::size_t LstmLayer::_loadPrefix(LstmPrefixCache& prefixCache, const Tensor& in, const std::uint8_t* mask,
+                                   TempData& tempData, Tensor::Type* outPtr) const
 {
+    auto interval = prefixCache.getInterval();
+    auto rowSize = in.getDims()[1];
+    auto checkpoints = in.getDims()[0] / interval;
+    auto& prefixHashes = tempData.prefixHashes;
+    auto& prefixCheckHashes = tempData.prefixCheckHashes;
+    prefixHashes.clear();
+    prefixCheckHashes.clear();
+
+    if(! checkpoints)
+    {
+        return 0;
+    }
+
+    // FNV-1a hash and multiply-xorshift check hash of the input values and mask, rolled over the sequence:
+    std::uint64_t hash = 14695981039346656037ULL;
+    std::uint64_t checkHash = 0x243f6a8885a308d3ULL;
+    auto inIt = in.getData().data();
+
+    for(std::size_t checkpoint = 0, step = 0; checkpoint != checkpoints; ++checkpoint)
+    {
+        for(auto stepEnd = step + interval; step != stepEnd; ++step)
+        {
+            for(auto inEnd = inIt + rowSize; inIt != inEnd; ++inIt)
+            {
+                std::uint64_t bits = 0;
+                std::memcpy(&bits, inIt, sizeof(Tensor::Type));
+                hash = (hash ^ bits) * 1099511628211ULL;
+                checkHash = (checkHash + bits) * 0x9e3779b97f4a7c15ULL;
+                checkHash ^= checkHash >> 29;
+            }
+
+            if(mask)
+            {
+                hash = (hash ^ mask[step]) * 1099511628211ULL;
+                checkHash = (checkHash + mask[step] + 1) * 0x9e3779b97f4a7c15ULL;
+                checkHash ^= checkHash >> 29;
+            }
+        }
+
+        prefixHashes.push_back(hash);
+        prefixCheckHashes.push_back(checkHash);
+    }
+
+    // Sequences outputs are needed for all steps, so the checkpoints chain is walked from the start.
+    // Otherwise, only the longest checkpointed prefix is needed:
+    auto& data = tempData.checkpoint;
+    auto outputsSize = _returnSequences ? interval * _units : 0;
+    data.resize(_units * 2 + outputsSize);
+
+    std::size_t loadedCheckpoints = 0;
+
+    if(_returnSequences)
+    {
+        while(loadedCheckpoints != checkpoints &&
+              prefixCache._get({ _id, prefixHashes[loadedCheckpoints], prefixCheckHashes[loadedCheckpoints],
+                                 (loadedCheckpoints + 1) * interval }, data.data(), data.size()))
+        {
+            std::copy(data.begin() + long(_units * 2), data.end(),
+                      outPtr + loadedCheckpoints * outputsSize);
+            ++loadedCheckpoints;
+        }
+    }
+    else
+    {
+        for(auto checkpoint = checkpoints; checkpoint != 0; --checkpoint)
+        {
+            if(prefixCache._get({ _id, prefixHashes[checkpoint - 1], prefixCheckHashes[checkpoint - 1],
+                                  checkpoint * interval }, data.data(), data.size()))
+            {
+                loadedCheckpoints = checkpoint;
+                break;
+            }
+        }
+    }
+
+    auto loadedSteps = loadedCheckpoints * interval;
+    prefixCache._registerLookup(loadedSteps);
+
+    if(loadedSteps)
+    {
+        std::copy(data.begin(), data.begin() + long(_units), tempData.ht.begin());
+        std::copy(data.begin() + long(_units), data.begin() + long(_units * 2), tempData.ct.begin());
+    }
+
+    return loadedSteps;
 }
 
-void LstmLayer::_step(TempData& tempData, Tensor& out) const
+void LstmLayer::_storePrefix(LstmPrefixCache& prefixCache, std::size_t steps, TempData& tempData,
+                             const Tensor::Type* outPtr) const
 {
-    tempData.dot(_wi, _bi, _ui, tempData.i);
-    _innerActivation->apply(tempData.i);
+    auto interval = prefixCache.getInterval();
+    auto& data = tempData.checkpoint;
+    auto outputsSize = _returnSequences ? interval * _units : 0;
+    data.resize(_units * 2 + outputsSize);
+
+    auto dataIt = std::copy(tempData.ht.begin(), tempData.ht.end(), data.begin());
+    dataIt = std::copy(tempData.ct.begin(), tempData.ct.end(), dataIt);
+
+    if(outputsSize)
+    {
+        std::copy(outPtr, outPtr + outputsSize, dataIt);
+    }
 
-    tempData.dot(_wf, _bf, _uf, tempData.f);
-    _innerActivation->apply(tempData.f);
+    auto checkpoint = steps / interval - 1;
+    prefixCache._put({ _id, tempData.prefixHashes[checkpoint], tempData.prefixCheckHashes[checkpoint], steps },
+                     data.data(), data.size());
+}
+
+const Tensor::Type* LstmLayer::_runSteps(const Tensor::Type* xw, std::ptrdiff_t xwInc, std::size_t steps,
+                                         const std::uint8_t* mask, TempData& tempData, Tensor::Type* outPtr,
+                                         std::ptrdiff_t outInc) const
+{
+    if(PT_LOOP_UNROLLING_ENABLE && _units % (Tensor::VectorSize * 2) == 0)
+    {
+        return _steps<Vector2MultiplyAdd>(xw, xwInc, steps, mask, tempData, outPtr, outInc);
+    }
+    else if(_units % Tensor::VectorSize == 0)
+    {
+        return _steps<VectorMultiplyAdd>(xw, xwInc, steps, mask, tempData, outPtr, outInc);
+    }
+    else
+    {
+        return _steps<ScalarMultiplyAdd>(xw, xwInc, steps, mask, tempData, outPtr, outInc);
+    }
+}
 
-    tempData.dot(_wc, _bc, _uc, tempData.c);
-    _activation->apply(tempData.c);
+template<class MultiplyAddType>
+const Tensor::Type* LstmLayer::_steps(const Tensor::Type* xw, std::ptrdiff_t xwInc, std::size_t steps,
+                                      const std::uint8_t* mask, TempData& tempData, Tensor::Type* outPtr,
+                                      std::ptrdiff_t outInc) const
+{
+    auto units = int(_units);
+    auto uBegin = _u.getData().data();
+    auto bBegin = _b.getData().data();
+    auto i = &*tempData.i.begin();
+    auto f = &*tempData.f.begin();
+    auto c = &*tempData.c.begin();
+    auto o = &*tempData.o.begin();
+    auto ht = &*tempData.ht.begin();
+    auto ct = &*tempData.ct.begin();
+    MultiplyAddType multiplyAdd;
+
+    for(std::size_t s = 0; s != steps; ++s)
+    {
+        if(mask && ! mask[s])
+        {
+            // Masked steps keep the previous state and output:
+            if(outPtr)
+            {
+                std::copy(ht, ht + units, outPtr);
+                outPtr += outInc;
+            }
+
+            continue;
+        }
 
-    tempData.dot(_wo, _bo, _uo, tempData.o);
-    _innerActivation->apply(tempData.o);
+        auto xwIt = xw;
+        auto uIt = uBegin;
+        auto bIt = bBegin;
+        xw += xwInc;
 
-    // join
+        for(Tensor::Type* gate : { i, f, c, o })
+        {
+            for(auto gateIt = gate, gateEnd = gate + units; gateIt != gateEnd; ++gateIt)
+            {
+                *gateIt = *xwIt + *bIt + multiplyAdd(uIt, ht, units);
+                ++xwIt;
+                ++bIt;
+                uIt += units;
+            }
+        }
 
-    tempData.f.multiply(tempData.ct, tempData.tmp1, tempData.dummyDispatcher);
+        _innerActivation->apply(tempData.i);
+        _innerActivation->apply(tempData.f);
+        _activation->apply(tempData.c);
+        _innerActivation->apply(tempData.o);
 
-    tempData.i.multiply(tempData.c, tempData.tmp2, tempData.dummyDispatcher);
+        for(int index = 0; index != units; ++index)
+        {
+            ct[index] = f[index] * ct[index] + i[index] * c[index];
+        }
 
-    // join
-    // seq
+        std::copy(ct, ct + units, c);
+        _activation->apply(tempData.c);
 
-    tempData.tmp1.add(tempData.tmp2, tempData.ct, tempData.dummyDispatcher);
+        for(int index = 0; index != units; ++index)
+        {
+            ht[index] = o[index] * c[index];
+        }
 
-    tempData.ct.copyTo(tempData.c);
-    _activation->apply(tempData.c);
+        if(outPtr)
+        {
+            std::copy(ht, ht + units, outPtr);
+            outPtr += outInc;
+        }
+    }
 
-    tempData.o.multiply(tempData.c, tempData.ht, tempData.dummyDispatcher);
-    tempData.ht.copyTo(out);
+    return xw;
 }
 
 }
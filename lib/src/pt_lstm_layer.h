@@ -8,45 +8,98 @@
 #ifndef PT_LSTM_LAYER_H
 #define PT_LSTM_LAYER_H
 
+#include <vector>
+#include <cstddef>
+#include <cstdint>
 #include "pt_tensor.h"
 #include "pt_activation_layer.h"
+#include "pt_temp_data_pool.h"
 
 namespace pt
 {
 
+class Dispatcher;
+class LstmPrefixCache;
+
 class LstmLayer : public Layer
 {
 
 public:
     static std::unique_ptr<LstmLayer> create(std::istream& stream);
 
+    ~LstmLayer() noexcept;
+
     bool apply(LayerData& layerData) const final;
 
 protected:
-    struct TempData;
-
-    Tensor _wi;
-    Tensor _ui;
-    Tensor _bi;
-    Tensor _wf;
-    Tensor _uf;
-    Tensor _bf;
-    Tensor _wc;
-    Tensor _uc;
-    Tensor _bc;
-    Tensor _wo;
-    Tensor _uo;
-    Tensor _bo;
+    friend class BidirectionalLayer;
+    friend class EmbeddingLstmLayer;
+    friend class RepeatVectorLstmLayer;
+
+    struct TempData
+    {
+        Tensor xw;
+        Tensor suffix;
+        std::vector<std::uint8_t> reversedMask;
+        std::vector<std::uint64_t> prefixHashes;
+        std::vector<std::uint64_t> prefixCheckHashes;
+        std::vector<Tensor::Type> checkpoint;
+        Tensor i;
+        Tensor f;
+        Tensor c;
+        Tensor o;
+        Tensor ht;
+        Tensor ct;
+
+        explicit TempData(std::size_t units) :
+            i(units),
+            f(units),
+            c(units),
+            o(units),
+            ht(units),
+            ct(units)
+        {
+        }
+    };
+
+    // Gate weights are fused in i, f, c, o order:
+    Tensor _w;
+    Tensor _u;
+    Tensor _b;
     std::unique_ptr<ActivationLayer> _innerActivation;
     std::unique_ptr<ActivationLayer> _activation;
+    std::size_t _units;
+    std::uint64_t _id;
     bool _returnSequences;
 
-    LstmLayer(Tensor&& wi, Tensor&& ui, Tensor&& bi, Tensor&& wf, Tensor&& uf, Tensor&& bf,
-          Tensor&& wc, Tensor&& uc, Tensor&& bc, Tensor&& wo, Tensor&& uo, Tensor&& bo,
-	      std::unique_ptr<ActivationLayer>&& innerActivation,
-	      std::unique_ptr<ActivationLayer>&& activation, bool returnSequences) noexcept;
+    mutable TempDataPool<TempData> _tempDataPool;
+
+    LstmLayer(Tensor&& w, Tensor&& u, Tensor&& b, std::unique_ptr<ActivationLayer>&& innerActivation,
+              std::unique_ptr<ActivationLayer>&& activation, bool returnSequences) noexcept;
+
+    // Input projections are computed from the input tensor if they are not given
+    // (xwInc is _units * 4 for one row per unmasked step, or 0 for a single row shared by all steps):
+    bool _apply(LayerData& layerData, std::size_t steps, const Tensor* xw, std::ptrdiff_t xwInc) const;
+
+    void _project(const Tensor& in, const std::uint8_t* mask, std::size_t firstStep, TempData& tempData,
+                  Dispatcher& dispatcher) const;
+
+    std::size_t _loadPrefix(LstmPrefixCache& prefixCache, const Tensor& in, const std::uint8_t* mask,
+                            TempData& tempData, Tensor::Type* outPtr) const;
+
+    void _storePrefix(LstmPrefixCache& prefixCache, std::size_t steps, TempData& tempData,
+                      const Tensor::Type* outPtr) const;
+
+    // xwInc is the input projections increment per unmasked step
+    // (0 if they are shared by all steps, negative if they are read backwards):
+    const Tensor::Type* _runSteps(const Tensor::Type* xw, std::ptrdiff_t xwInc, std::size_t steps,
+                                  const std::uint8_t* mask, TempData& tempData, Tensor::Type* outPtr,
+                                  std::ptrdiff_t outInc) const;
 
-    void _step(TempData& tempData, Tensor& out) const;
+    template<class MultiplyAddType>
+    const Tensor::Type* _steps(const Tensor::Type* xw, std::ptrdiff_t xwInc, std::size_t steps,
+                               const std::uint8_t* mask, TempData& tempData, Tensor::Type* outPtr,
+                               std::ptrdiff_t outInc) const;
 };
 
 }
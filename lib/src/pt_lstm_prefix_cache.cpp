@@ -0,0 +1,150 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_lstm_prefix_cache.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace pt
+{
+
+LstmPrefixCache::LstmPrefixCache(std::size_t maxBytes, std::size_t interval) :
+    _maxBytes(maxBytes),
+    _interval(std::max(interval, std::size_t(1))),
+    _bytes(0),
+    _hits(0),
+    _misses(0),
+    _skippedSteps(0)
+{
+}
+
+std::size_t LstmPrefixCache::getBytes() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _bytes;
+}
+
+std::size_t LstmPrefixCache::getEntriesCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+std::size_t LstmPrefixCache::getHits() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _hits;
+}
+
+std::size_t LstmPrefixCache::getMisses() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _misses;
+}
+
+std::size_t LstmPrefixCache::getSkippedSteps() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _skippedSteps;
+}
+
+void LstmPrefixCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entriesMap.clear();
+    _entries.clear();
+    _bytes = 0;
+    _hits = 0;
+    _misses = 0;
+    _skippedSteps = 0;
+}
+
+std::size_t LstmPrefixCache::KeyHash::operator()(const Key& key) const noexcept
+{
+    auto hash = std::size_t(key.hash);
+    hash ^= std::size_t(key.layerId) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= key.steps + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+std::size_t LstmPrefixCache::_entryBytes(std::size_t size) noexcept
+{
+    // Entry data, list node (entry and two links) and hash map node (value, next link, cached hash and bucket):
+    using MapValue = std::pair<const Key, EntryList::iterator>;
+    auto listNodeBytes = sizeof(Entry) + sizeof(void*) * 2;
+    auto mapNodeBytes = sizeof(MapValue) + sizeof(void*) + sizeof(std::size_t) + sizeof(void*);
+    return size * sizeof(Tensor::Type) + listNodeBytes + mapNodeBytes;
+}
+
+bool LstmPrefixCache::_get(const Key& key, Tensor::Type* data, std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entriesMap.find(key);
+
+    if(it == _entriesMap.end())
+    {
+        return false;
+    }
+
+    auto entryIt = it->second;
+
+    if(entryIt->data.size() != size)
+    {
+        return false;
+    }
+
+    std::copy(entryIt->data.begin(), entryIt->data.end(), data);
+    _entries.splice(_entries.begin(), _entries, entryIt);
+    return true;
+}
+
+void LstmPrefixCache::_put(const Key& key, const Tensor::Type* data, std::size_t size)
+{
+    auto bytes = _entryBytes(size);
+
+    if(bytes > _maxBytes)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(_entriesMap.find(key) != _entriesMap.end())
+    {
+        return;
+    }
+
+    while(_bytes + bytes > _maxBytes)
+    {
+        const Entry& lastEntry = _entries.back();
+        _bytes -= _entryBytes(lastEntry.data.size());
+        _entriesMap.erase(lastEntry.key);
+        _entries.pop_back();
+    }
+
+    _entries.push_front(Entry{ key, std::vector<Tensor::Type>(data, data + size) });
+    _entriesMap.emplace(key, _entries.begin());
+    _bytes += bytes;
+}
+
+void LstmPrefixCache::_registerLookup(std::size_t skippedSteps)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if(skippedSteps)
+    {
+        ++_hits;
+        _skippedSteps += skippedSteps;
+    }
+    else
+    {
+        ++_misses;
+    }
+}
+
+}
@@ -0,0 +1,95 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_masking_layer.h"
+
+#include "pt_parser.h"
+#include "pt_layer_data.h"
+
+namespace pt
+{
+
+std::unique_ptr<MaskingLayer> MaskingLayer::create(std::istream& stream)
+{
+    float maskValue = 0;
+
+    if(! Parser::parse(stream, maskValue))
+    {
+        PT_LOG_ERROR << "Mask value parse failed" << std::endl;
+        return nullptr;
+    }
+
+    return std::unique_ptr<MaskingLayer>(new MaskingLayer(FloatType(maskValue)));
+}
+
+bool MaskingLayer::apply(LayerData& layerData) const
+{
+    Tensor& in = layerData.in;
+
+    if(in.getDims().size() == 1)
+    {
+        // Single step:
+        in.resize(1, in.getDims()[0]);
+    }
+
+    const auto& iw = in.getDims();
+
+    if(iw.size() != 2)
+    {
+        PT_LOG_ERROR << "Input tensor dims count must be 1 or 2" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
+        return false;
+    }
+
+    Tensor& out = layerData.out;
+    out = std::move(in);
+
+    // Steps with all values equal to the mask value are masked and zeroed:
+    auto& mask = layerData.mask;
+    auto steps = out.getDims()[0];
+    auto rowSize = long(out.getDims()[1]);
+    bool masked = false;
+    mask.resize(steps);
+
+    for(std::size_t step = 0; step != steps; ++step)
+    {
+        auto rowIt = out.begin() + long(step) * rowSize;
+        auto rowEnd = rowIt + rowSize;
+        bool keep = false;
+
+        for(auto it = rowIt; it != rowEnd; ++it)
+        {
+            if(*it < _maskValue || *it > _maskValue)
+            {
+                keep = true;
+                break;
+            }
+        }
+
+        if(! keep)
+        {
+            std::fill(rowIt, rowEnd, FloatType(0));
+            masked = true;
+        }
+
+        mask[step] = keep;
+    }
+
+    if(! masked)
+    {
+        mask.clear();
+    }
+
+    return true;
+}
+
+MaskingLayer::MaskingLayer(FloatType maskValue) noexcept :
+    _maskValue(maskValue)
+{
+}
+
+}
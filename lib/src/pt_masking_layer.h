@@ -0,0 +1,33 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_MASKING_LAYER_H
+#define PT_MASKING_LAYER_H
+
+#include "pt_libsimdpp.h"
+#include "pt_layer.h"
+
+namespace pt
+{
+
+class MaskingLayer : public Layer
+{
+
+public:
+    static std::unique_ptr<MaskingLayer> create(std::istream& stream);
+
+    bool apply(LayerData& layerData) const final;
+
+protected:
+    FloatType _maskValue;
+
+    explicit MaskingLayer(FloatType maskValue) noexcept;
+};
+
+}
+
+#endif
@@ -8,153 +8,102 @@
 #include "pt_max_pooling_2d_layer.h"
 
 #include <array>
-#include "pt_parser.h"
+#include <algorithm>
 #include "pt_dispatcher.h"
 #include "pt_layer_data.h"
-#include "pt_max.h"
+#include "pt_output_tiles.h"
+#include "pt_pooling.h"
 
 namespace pt
 {
 
-namespace
+std::unique_ptr<MaxPooling2DLayer> MaxPooling2DLayer::create(std::istream& stream)
 {
-    template<class MaxType>
-    void maxImpl(int poolSizeY, int poolSizeX, LayerData& layerData)
-    {
-        struct Task
-        {
-            int poolSizeY;
-            int poolSizeX;
-            LayerData* layerData;
-            int threads;
-            int taskId;
-
-            void operator()() noexcept
-            {
-                const Tensor& in = layerData->in;
-                Tensor& out = layerData->out;
-
-                const auto& iw = in.getDims();
-                const auto& ow = out.getDims();
-                auto inIncY2 = int(iw[2] * iw[1]);
-                auto inIncY = inIncY2 * poolSizeY;
-                auto inIncX2 = int(iw[2]);
-                auto inIncX = inIncX2 * poolSizeX;
-                auto outInc2 = int(iw[2] * ow[1]);
-                auto outInc = outInc2 * int(ow[0]);
-
-                auto inData = in.getData().data();
-                auto outData = const_cast<Tensor::Type*>(out.getData().data());
-                MaxType max;
-
-                int its = outInc / outInc2;
-                int taskIts = its / threads;
-                int taskBegin = taskIts * taskId;
-                int taskEnd;
-
-                if(taskId == threads - 1)
-                {
-                    taskEnd = its;
-                }
-                else
-                {
-                    taskEnd = taskBegin + taskIts;
-                }
-
-                inData += taskIts * taskId * inIncY;
-
-                for(auto outIt = outData + (taskBegin * outInc2), outEnd = outData + (taskEnd * outInc2);
-                    outIt != outEnd; outIt += outInc2)
-                {
-                    auto inIt = inData;
-                    inData += inIncY;
-
-                    for(auto outIt2 = outIt, outEnd2 = outIt + outInc2; outIt2 != outEnd2; outIt2 += inIncX2)
-                    {
-                        for(auto inIt2 = inIt, inEnd2 = inIt + inIncY; inIt2 != inEnd2; inIt2 += inIncY2)
-                        {
-                            for(auto inIt3 = inIt2, inEnd3 = inIt2 + inIncX; inIt3 != inEnd3; inIt3 += inIncX2)
-                            {
-                                max(&*inIt3, &*outIt2, inIncX2);
-                            }
-                        }
-
-                        inIt += inIncX;
-                    }
-                }
-            }
-        };
+    Params params;
 
-        std::array<Task, PT_MAX_CPU_THREADS> tasks;
-        Dispatcher& dispatcher = layerData.dispatcher;
-        auto threads = int(dispatcher.threads());
-
-        for(int taskId = 0; taskId != threads; ++taskId)
-        {
-            Task& task = tasks[std::size_t(taskId)];
-            task = Task{ poolSizeY, poolSizeX, &layerData, threads, taskId };
-            dispatcher.add([&task]{ task(); });
-        }
-
-        dispatcher.join();
+    if(! _parse(stream, params))
+    {
+        return nullptr;
     }
+
+    return std::unique_ptr<MaxPooling2DLayer>(new MaxPooling2DLayer(params));
 }
 
-std::unique_ptr<MaxPooling2DLayer> MaxPooling2DLayer::create(std::istream& stream)
+bool MaxPooling2DLayer::_isFusable() const noexcept
 {
-    unsigned int poolSizeY = 0;
+    return _strideY == _poolSizeY && _strideX == _poolSizeX && ! _samePadding;
+}
 
-    if(! Parser::parse(stream, poolSizeY))
+void MaxPooling2DLayer::_apply(LayerData& layerData, const Geometry& geometry) const
+{
+    struct Task
     {
-        PT_LOG_ERROR << "Pool size Y parse failed" << std::endl;
-        return nullptr;
-    }
+        const MaxPooling2DLayer* layer;
+        const Geometry* geometry;
+        const OutputTiles* tiles;
+        LayerData* layerData;
+        int taskId;
 
-    unsigned int poolSizeX = 0;
+        void operator()() noexcept
+        {
+            const Tensor& in = layerData->in;
+            Tensor& out = layerData->out;
 
-    if(! Parser::parse(stream, poolSizeX))
-    {
-        PT_LOG_ERROR << "Pool size X parse failed" << std::endl;
-        return nullptr;
-    }
+            const auto& iw = in.getDims();
+            auto rows = int(iw[0]);
+            auto cols = int(iw[1]);
+            auto channels = int(iw[2]);
+            auto inIncY = cols * channels;
+            auto outIncY = geometry->outX * channels;
 
-    return std::unique_ptr<MaxPooling2DLayer>(new MaxPooling2DLayer(int(poolSizeY), int(poolSizeX)));
-}
+            auto inBegin = in.getData().data();
+            auto outBegin = const_cast<Tensor::Type*>(out.getData().data());
 
-bool MaxPooling2DLayer::apply(LayerData& layerData) const
-{
-    const Tensor& in = layerData.in;
-    const auto& iw = in.getDims();
+            for(int index = tiles->taskBegin(taskId), end = tiles->taskEnd(taskId); index != end; ++index)
+            {
+                OutputTiles::Tile tile = tiles->tile(index);
+                auto size = tile.channelEnd - tile.channelBegin;
 
-    if(iw.size() != 3)
-    {
-        PT_LOG_ERROR << "Input tensor dims count must be 3" <<
-                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
-        return false;
-    }
+                // Window rows and columns outside of the input are padding, so they are skipped:
+                int iy = tile.row * layer->_strideY - geometry->padTop;
+                int yBegin = std::max(iy, 0);
+                int yEnd = std::min(iy + layer->_poolSizeY, rows);
 
+                for(int x = tile.colBegin; x != tile.colEnd; ++x)
+                {
+                    int ix = x * layer->_strideX - geometry->padLeft;
+                    int xBegin = std::max(ix, 0);
+                    int xEnd = std::min(ix + layer->_poolSizeX, cols);
+                    PoolWindow window{ yEnd - yBegin, xEnd - xBegin, inIncY, channels };
+
+                    auto inPixel = inBegin + yBegin * inIncY + xBegin * channels + tile.channelBegin;
+                    auto outPixel = outBegin + tile.row * outIncY + x * channels + tile.channelBegin;
+                    poolChannels<MaxPooling>(inPixel, window, outPixel, size);
+                }
+            }
+        }
+    };
+
+    const auto& iw = layerData.in.getDims();
+    auto channels = int(iw[2]);
     Tensor& out = layerData.out;
-    out.resize(iw[0] / std::size_t(_poolSizeY), iw[1] / std::size_t(_poolSizeX), iw[2]);
-    out.fill(-std::numeric_limits<Tensor::Type>::infinity());
+    out.resize(std::size_t(geometry.outY), std::size_t(geometry.outX), iw[2]);
 
+    // Channel blocks are only split if the overlapped last vectors don't cross them:
+    std::array<Task, PT_MAX_CPU_THREADS> tasks;
     Dispatcher& dispatcher = layerData.dispatcher;
     auto threads = int(dispatcher.threads());
-    auto threadSize = int(iw[2]) / threads;
+    int channelStep = channels % Tensor::VectorSize == 0 ? int(Tensor::VectorSize) : channels;
+    OutputTiles tiles{ geometry.outY, geometry.outX, channels, 1, channelStep, threads };
 
-    if(PT_LOOP_UNROLLING_ENABLE && threadSize && threadSize % (Tensor::VectorSize * 2) == 0)
-    {
-        maxImpl<Vector2Max>(_poolSizeY, _poolSizeX, layerData);
-    }
-    else if(threadSize && threadSize % Tensor::VectorSize == 0)
-    {
-        maxImpl<VectorMax>(_poolSizeY, _poolSizeX, layerData);
-    }
-    else
+    for(int taskId = 0; taskId != threads; ++taskId)
     {
-        maxImpl<ScalarMax>(_poolSizeY, _poolSizeX, layerData);
+        Task& task = tasks[std::size_t(taskId)];
+        task = Task{ this, &geometry, &tiles, &layerData, taskId };
+        dispatcher.add([&task]{ task(); });
     }
 
-    return true;
+    dispatcher.join();
 }
 
 }
@@ -8,28 +8,29 @@
 #ifndef PT_MAX_POOLING_2D_LAYER_H
 #define PT_MAX_POOLING_2D_LAYER_H
 
-#include "pt_layer.h"
+#include "pt_pooling_2d_layer.h"
 
 namespace pt
 {
 
-class MaxPooling2DLayer : public Layer
+class MaxPooling2DLayer : public Pooling2DLayer
 {
 
 public:
     static std::unique_ptr<MaxPooling2DLayer> create(std::istream& stream);
 
-    bool apply(LayerData& layerData) const final;
-
 protected:
-    int _poolSizeY;
-    int _poolSizeX;
+    friend class Conv2DMaxPooling2DLayer;
 
-    MaxPooling2DLayer(int poolSizeY, int poolSizeX) noexcept :
-        _poolSizeY(poolSizeY),
-        _poolSizeX(poolSizeX)
+    explicit MaxPooling2DLayer(const Params& params) noexcept :
+        Pooling2DLayer(params)
     {
     }
+
+    // Non-overlapping windows without padding, which can be fused with previous layers:
+    bool _isFusable() const noexcept;
+
+    void _apply(LayerData& layerData, const Geometry& geometry) const final;
 };
 
 }
@@ -7,15 +7,146 @@
 
 #include "pt_model.h"
 
+#include <atomic>
 #include <string>
 #include <fstream>
+#include <algorithm>
 #include "pt_parser.h"
 #include "pt_dispatcher.h"
 #include "pt_layer_data.h"
+#include "pt_rnn_state.h"
+#include "pt_spatial_layer.h"
+#include "pt_input_layer.h"
+#include "pt_embedding_lstm_layer.h"
+#include "pt_repeat_vector_lstm_layer.h"
+#include "pt_conv_2d_max_pooling_2d_layer.h"
 
 namespace pt
 {
 
+namespace
+{
+    // RNN states are bound to model ids instead of addresses, so they can't be reused by a new model
+    // allocated at the address of a destroyed one (0 is an unbound state):
+    std::atomic<std::uint64_t> nextModelId(1);
+
+    // Model files start with a magic number ("PTOM") and a format version.
+    // Files without them were exported by an older pt.py, before layers gained new fields:
+    constexpr unsigned int formatMagic = 0x4d4f5450;
+    constexpr unsigned int formatVersion = 2;
+
+    // Layers from the given one which can be applied tile by tile:
+    std::vector<const SpatialLayer*> tiledLayers(const std::vector<std::unique_ptr<Layer>>& layers,
+                                                 std::size_t begin)
+    {
+        std::vector<const SpatialLayer*> result;
+
+        for(std::size_t i = begin, l = layers.size(); i != l; ++i)
+        {
+            auto layer = dynamic_cast<const SpatialLayer*>(layers[i].get());
+
+            if(! layer || ! layer->isTileable())
+            {
+                break;
+            }
+
+            result.push_back(layer);
+        }
+
+        return result;
+    }
+
+    void copyRegion(const Tensor& in, const SpatialLayer::Region& region, Tensor& out)
+    {
+        const auto& iw = in.getDims();
+        auto channels = iw[2];
+        auto rowSize = std::size_t(region.cols) * channels;
+        out.resize(std::size_t(region.rows), std::size_t(region.cols), channels);
+
+        auto inIt = in.begin() + std::ptrdiff_t((std::size_t(region.y) * iw[1] + std::size_t(region.x)) * channels);
+        auto outIt = out.begin();
+
+        for(int row = 0; row != region.rows; ++row)
+        {
+            std::copy(inIt, inIt + std::ptrdiff_t(rowSize), outIt);
+            inIt += std::ptrdiff_t(iw[1] * channels);
+            outIt += std::ptrdiff_t(rowSize);
+        }
+    }
+
+    void pasteRegion(const Tensor& in, const SpatialLayer::Region& region, Tensor& out)
+    {
+        const auto& ow = out.getDims();
+        auto channels = ow[2];
+        auto rowSize = std::size_t(region.cols) * channels;
+
+        auto inIt = in.begin();
+        auto outIt = out.begin() + std::ptrdiff_t((std::size_t(region.y) * ow[1] + std::size_t(region.x)) * channels);
+
+        for(int row = 0; row != region.rows; ++row)
+        {
+            std::copy(inIt, inIt + std::ptrdiff_t(rowSize), outIt);
+            inIt += std::ptrdiff_t(rowSize);
+            outIt += std::ptrdiff_t(ow[1] * channels);
+        }
+    }
+
+    // Depth-first execution: for each output tile, the input regions of all layers are computed backwards
+    // (with halos for convolution kernels) and then the layers are applied to them one by one:
+    bool applyTiled(const std::vector<const SpatialLayer*>& layers, int tileSize, LayerData& layerData)
+    {
+        std::size_t layersCount = layers.size();
+        std::vector<Tensor::DimsVector> dims(layersCount + 1);
+        dims[0] = layerData.in.getDims();
+
+        for(std::size_t i = 0; i != layersCount; ++i)
+        {
+            if(! layers[i]->getOutputDims(dims[i], dims[i + 1]))
+            {
+                return false;
+            }
+        }
+
+        const auto& ow = dims[layersCount];
+        Tensor result(ow[0], ow[1], ow[2]);
+        Tensor tileOut;
+        LayerData tileData{ Tensor(), tileOut, layerData.dispatcher, layerData.config, nullptr, {}, {} };
+        std::vector<SpatialLayer::Region> regions(layersCount + 1);
+
+        for(int y = 0, rows = int(ow[0]); y < rows; y += tileSize)
+        {
+            for(int x = 0, cols = int(ow[1]); x < cols; x += tileSize)
+            {
+                regions[layersCount] = SpatialLayer::Region{ y, x, std::min(tileSize, rows - y),
+                                                             std::min(tileSize, cols - x) };
+
+                for(std::size_t i = layersCount; i != 0; --i)
+                {
+                    regions[i - 1] = layers[i - 1]->getInputRegion(dims[i - 1], regions[i]);
+                }
+
+                copyRegion(layerData.in, regions[0], tileData.in);
+
+                for(std::size_t i = 0; i != layersCount; ++i)
+                {
+                    if(! layers[i]->applyTile(tileData, dims[i], regions[i], regions[i + 1]))
+                    {
+                        return false;
+                    }
+
+                    // Buffers are swapped instead of moved, so they are reused by the next tiles:
+                    std::swap(tileData.in, tileOut);
+                }
+
+                pasteRegion(tileData.in, regions[layersCount], result);
+            }
+        }
+
+        layerData.out = std::move(result);
+        return true;
+    }
+}
+
 std::unique_ptr<Model> Model::create(const std::string& filePath)
 {
     std::ifstream stream(filePath, std::ios::binary);
@@ -39,6 +170,38 @@ std::unique_ptr<Model> Model::create(const std::string& filePath)
 
 std::unique_ptr<Model> Model::create(std::istream& stream)
 {
+    unsigned int magic = 0;
+
+    if(! Parser::parse(stream, magic))
+    {
+        PT_LOG_ERROR << "Magic number parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(magic != formatMagic)
+    {
+        PT_LOG_ERROR << "Invalid magic number: " << magic <<
+                            " (models exported by an older pt.py must be exported again with the current one)" <<
+                            std::endl;
+        return nullptr;
+    }
+
+    unsigned int version = 0;
+
+    if(! Parser::parse(stream, version))
+    {
+        PT_LOG_ERROR << "Format version parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(version != formatVersion)
+    {
+        PT_LOG_ERROR << "Unsupported format version: " << version << " (expected: " << formatVersion << ")" <<
+                            " (the model must be exported again with the pt.py of this library version)" <<
+                            std::endl;
+        return nullptr;
+    }
+
     unsigned int layersCount = 0;
 
     if(! Parser::parse(stream, layersCount))
@@ -68,6 +231,10 @@ std::unique_ptr<Model> Model::create(std::istream& stream)
         layers.push_back(std::move(layer));
     }
 
+    Conv2DMaxPooling2DLayer::fuse(layers);
+    EmbeddingLstmLayer::fuse(layers);
+    RepeatVectorLstmLayer::fuse(layers);
+
     return std::unique_ptr<Model>(new Model(std::move(layers)));
 }
 
@@ -79,6 +246,82 @@ bool Model::predict(Tensor in, Tensor& out) const
 }
 
 bool Model::predict(Dispatcher& dispatcher, Tensor in, Tensor& out) const
+{
+    return _apply(dispatcher, nullptr, std::move(in), out);
+}
+
+bool Model::step(RnnState& state, Tensor in, Tensor& out) const
+{
+    Dispatcher dispatcher;
+
+    return step(dispatcher, state, std::move(in), out);
+}
+
+bool Model::step(Dispatcher& dispatcher, RnnState& state, Tensor in, Tensor& out) const
+{
+    if(! _bindState(state))
+    {
+        return false;
+    }
+
+    return _apply(dispatcher, &state, std::move(in), out);
+}
+
+bool Model::predict(TokenVector in, Tensor& out) const
+{
+    Dispatcher dispatcher;
+
+    return predict(dispatcher, std::move(in), out);
+}
+
+bool Model::predict(Dispatcher& dispatcher, TokenVector in, Tensor& out) const
+{
+    return _apply(dispatcher, nullptr, std::move(in), out);
+}
+
+bool Model::step(RnnState& state, TokenVector in, Tensor& out) const
+{
+    Dispatcher dispatcher;
+
+    return step(dispatcher, state, std::move(in), out);
+}
+
+bool Model::step(Dispatcher& dispatcher, RnnState& state, TokenVector in, Tensor& out) const
+{
+    if(! _bindState(state))
+    {
+        return false;
+    }
+
+    return _apply(dispatcher, &state, std::move(in), out);
+}
+
+Model::Model(std::vector<std::unique_ptr<Layer>>&& layers) noexcept :
+    _layers(std::move(layers)),
+    _id(nextModelId++)
+{
+}
+
+bool Model::_bindState(RnnState& state) const
+{
+    if(! state._modelId)
+    {
+        state._modelId = _id;
+        state._layerStates.clear();
+        state._layerStates.resize(_layers.size());
+        return true;
+    }
+
+    if(state._modelId != _id || state._layerStates.size() != _layers.size())
+    {
+        PT_LOG_ERROR << "RNN state belongs to another model (reset it before using it with this model)" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Model::_apply(Dispatcher& dispatcher, RnnState* state, Tensor in, Tensor& out) const
 {
     if(! in.isValid())
     {
@@ -86,32 +329,86 @@ bool Model::predict(Dispatcher& dispatcher, Tensor in, Tensor& out) const
         return false;
     }
 
-    LayerData layerData{ std::move(in), out, dispatcher, _config };
+    LayerData layerData{ std::move(in), out, dispatcher, _config, nullptr, {}, {} };
+    return _apply(state, layerData);
+}
+
+bool Model::_apply(Dispatcher& dispatcher, RnnState* state, TokenVector in, Tensor& out) const
+{
+    if(in.empty())
+    {
+        PT_LOG_ERROR << "Input tokens are empty" << std::endl;
+        return false;
+    }
+
+    // Tokens are only read by Embedding layers, so one of them must be the first layer (after Input layers):
+    for(const auto& layer : _layers)
+    {
+        if(! dynamic_cast<const InputLayer*>(layer.get()))
+        {
+            if(! dynamic_cast<const EmbeddingLayer*>(layer.get()) &&
+               ! dynamic_cast<const EmbeddingLstmLayer*>(layer.get()))
+            {
+                PT_LOG_ERROR << "Input tokens require an Embedding first layer" << std::endl;
+                return false;
+            }
+
+            break;
+        }
+    }
+
+    LayerData layerData{ Tensor(), out, dispatcher, _config, nullptr, {}, std::move(in) };
+    return _apply(state, layerData);
+}
+
+bool Model::_apply(RnnState* state, LayerData& layerData) const
+{
     std::size_t layersCount = _layers.size();
+    auto tileSize = int(_config.getTileSize());
 
-    for(std::size_t i = 0; i != layersCount - 1; ++i)
+    for(std::size_t i = 0; i != layersCount; ++i)
     {
+        if(tileSize && layerData.in.getDims().size() == 3)
+        {
+            auto layers = tiledLayers(_layers, i);
+
+            if(layers.size() > 1)
+            {
+                if(! applyTiled(layers, tileSize, layerData))
+                {
+                    PT_LOG_ERROR << "Tiled layers apply failed" << std::endl;
+                    return false;
+                }
+
+                i += layers.size() - 1;
+
+                if(i != layersCount - 1)
+                {
+                    layerData.in = std::move(layerData.out);
+                }
+
+                continue;
+            }
+        }
+
+        if(state)
+        {
+            layerData.state = &state->_layerStates[i];
+        }
+
         if(! _layers[i]->apply(layerData))
         {
             PT_LOG_ERROR << "Layer apply failed" << std::endl;
             return false;
         }
 
-        layerData.in = std::move(layerData.out);
-    }
-
-    if(! _layers[layersCount - 1]->apply(layerData))
-    {
-        PT_LOG_ERROR << "Layer apply failed" << std::endl;
-        return false;
+        if(i != layersCount - 1)
+        {
+            layerData.in = std::move(layerData.out);
+        }
     }
 
     return true;
 }
 
-Model::Model(std::vector<std::unique_ptr<Layer>>&& layers) noexcept :
-    _layers(std::move(layers))
-{
-}
-
 }
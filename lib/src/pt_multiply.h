@@ -15,11 +15,11 @@ namespace pt
 
 struct ScalarMultiply
 {
-    PT_INLINE void operator()(const Tensor::Type* a, Tensor::Type* r, int length) noexcept
+    PT_INLINE void operator()(const Tensor::Type* a, const Tensor::Type* b, Tensor::Type* r, int length) noexcept
     {
         for(int index = 0; index != length; ++index)
         {
-            *(r + index) *= *(a + index);
+            *(r + index) = *(a + index) * *(b + index);
         }
     }
 };
@@ -27,14 +27,13 @@ struct ScalarMultiply
 
 struct VectorMultiply
 {
-    PT_INLINE void operator()(const Tensor::Type* a, Tensor::Type* r, int length) noexcept
+    PT_INLINE void operator()(const Tensor::Type* a, const Tensor::Type* b, Tensor::Type* r, int length) noexcept
     {
         for(int index = 0; index != length; index += Tensor::VectorSize)
         {
             Tensor::Vector av = simdpp::load(a + index);
-            Tensor::Vector rv = simdpp::load(r + index);
-            rv = simdpp::mul(av, rv);
-            simdpp::store(r + index, rv);
+            Tensor::Vector bv = simdpp::load(b + index);
+            simdpp::store(r + index, simdpp::mul(av, bv));
         }
     }
 };
@@ -42,18 +41,16 @@ struct VectorMultiply
 
 struct Vector2Multiply
 {
-    PT_INLINE void operator()(const Tensor::Type* a, Tensor::Type* r, int length) noexcept
+    PT_INLINE void operator()(const Tensor::Type* a, const Tensor::Type* b, Tensor::Type* r, int length) noexcept
     {
         for(int index = 0, inc = Tensor::VectorSize; index != length; index += inc * 2)
         {
             Tensor::Vector av1 = simdpp::load(a + index);
-            Tensor::Vector rv1 = simdpp::load(r + index);
+            Tensor::Vector bv1 = simdpp::load(b + index);
             Tensor::Vector av2 = simdpp::load(a + index + inc);
-            Tensor::Vector rv2 = simdpp::load(r + index + inc);
-            rv1 = simdpp::mul(av1, rv1);
-            rv2 = simdpp::mul(av2, rv2);
-            simdpp::store(r + index, rv1);
-            simdpp::store(r + index + inc, rv2);
+            Tensor::Vector bv2 = simdpp::load(b + index + inc);
+            simdpp::store(r + index, simdpp::mul(av1, bv1));
+            simdpp::store(r + index + inc, simdpp::mul(av2, bv2));
         }
     }
 };
@@ -37,6 +37,15 @@ struct ScalarMultiplyAdd
         }
     }
 
+    PT_INLINE void operator()(const Tensor::Type* a, const Tensor::Type* b, const Tensor::Type* c,
+                                  Tensor::Type* r, int length) noexcept
+    {
+        for(int index = 0; index != length; ++index)
+        {
+            *(r + index) = *(a + index) * *(b  + index) + *(c + index);
+        }
+    }
+
     PT_INLINE Tensor::Type operator()(const Tensor::Type* a, const Tensor::Type* b,
                                           int length) noexcept
     {
@@ -65,6 +74,16 @@ struct VectorMultiplyAdd
         }
     }
 
+    PT_INLINE void operator()(const Tensor::Type* a, const Tensor::Type* b, const Tensor::Type* c,
+                                  Tensor::Type* r, int length) noexcept
+    {
+        for(int index = 0; index != length; index += Tensor::VectorSize)
+        {
+            Tensor::Vector rv = detail::madd(simdpp::load(a + index), simdpp::load(b + index), simdpp::load(c + index));
+            simdpp::store(r + index, rv);
+        }
+    }
+
     PT_INLINE Tensor::Type operator()(const Tensor::Type* a, const Tensor::Type* b,
                                           int length) noexcept
     {
@@ -96,6 +115,20 @@ struct Vector2MultiplyAdd
         }
     }
 
+    PT_INLINE void operator()(const Tensor::Type* a, const Tensor::Type* b, const Tensor::Type* c,
+                                  Tensor::Type* r, int length) noexcept
+    {
+        for(int index = 0, inc = Tensor::VectorSize; index != length; index += inc * 2)
+        {
+            Tensor::Vector rv1 = detail::madd(simdpp::load(a + index), simdpp::load(b + index),
+                                              simdpp::load(c + index));
+            Tensor::Vector rv2 = detail::madd(simdpp::load(a + index + inc), simdpp::load(b + index + inc),
+                                              simdpp::load(c + index + inc));
+            simdpp::store(r + index, rv1);
+            simdpp::store(r + index + inc, rv2);
+        }
+    }
+
     PT_INLINE Tensor::Type operator()(const Tensor::Type* a, const Tensor::Type* b,
                                           int length) noexcept
     {
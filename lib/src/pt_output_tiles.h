@@ -0,0 +1,126 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_OUTPUT_TILES_H
+#define PT_OUTPUT_TILES_H
+
+#include <algorithm>
+
+namespace pt
+{
+
+// Splits a (rows, columns, channels) output in (row, column tile, channel block) tiles, so small spatial outputs
+// still provide work for every thread:
+class OutputTiles
+{
+
+public:
+    struct Tile
+    {
+        int row;
+        int colBegin;
+        int colEnd;
+        int channelBegin;
+        int channelEnd;
+    };
+
+    // Column tiles and channel blocks are multiples of colStep and channelStep, except the last ones:
+    OutputTiles(int rows, int cols, int channels, int colStep, int channelStep, int threads) noexcept :
+        _cols(cols),
+        _channels(channels),
+        _colSize(std::max(cols, 1)),
+        _channelSize(std::max(channels, 1)),
+        _threads(threads)
+    {
+        int minCount = threads > 1 ? threads * _tilesPerThread : 1;
+
+        // Columns are split first, since channel blocks read the same input several times:
+        while(rows * _colTiles() * _channelBlocks() < minCount)
+        {
+            if(_colSize > colStep)
+            {
+                _colSize = _half(_colSize, colStep);
+            }
+            else if(_channelSize > channelStep)
+            {
+                _channelSize = _half(_channelSize, channelStep);
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        _count = rows * _colTiles() * _channelBlocks();
+    }
+
+    int count() const noexcept
+    {
+        return _count;
+    }
+
+    int maxCols() const noexcept
+    {
+        return _colSize;
+    }
+
+    // Contiguous and balanced tile ranges for each task:
+    int taskBegin(int taskId) const noexcept
+    {
+        return int(long(_count) * taskId / _threads);
+    }
+
+    int taskEnd(int taskId) const noexcept
+    {
+        return int(long(_count) * (taskId + 1) / _threads);
+    }
+
+    Tile tile(int index) const noexcept
+    {
+        int channelBlocks = _channelBlocks();
+        int colTiles = _colTiles();
+        int channelBlock = index % channelBlocks;
+        index /= channelBlocks;
+
+        int colTile = index % colTiles;
+        int row = index / colTiles;
+        int colBegin = colTile * _colSize;
+        int channelBegin = channelBlock * _channelSize;
+        return Tile{ row, colBegin, std::min(colBegin + _colSize, _cols),
+                     channelBegin, std::min(channelBegin + _channelSize, _channels) };
+    }
+
+protected:
+    static constexpr int _tilesPerThread = 4;
+
+    int _cols;
+    int _channels;
+    int _colSize;
+    int _channelSize;
+    int _threads;
+    int _count;
+
+    static int _half(int size, int step) noexcept
+    {
+        int half = (size + 1) / 2;
+        return (half + step - 1) / step * step;
+    }
+
+    int _colTiles() const noexcept
+    {
+        return (_cols + _colSize - 1) / _colSize;
+    }
+
+    int _channelBlocks() const noexcept
+    {
+        return (_channels + _channelSize - 1) / _channelSize;
+    }
+};
+
+}
+
+#endif
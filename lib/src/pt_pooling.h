@@ -0,0 +1,263 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_POOLING_H
+#define PT_POOLING_H
+
+#include <array>
+#include <algorithm>
+#include "pt_tensor.h"
+#include "pt_dispatcher.h"
+#include "pt_layer_data.h"
+
+namespace pt
+{
+
+// Pooled values of an output pixel: rows of cols pixels, inIncY and inIncX values apart:
+struct PoolWindow
+{
+    int rows;
+    int cols;
+    int inIncY;
+    int inIncX;
+};
+
+
+struct MaxPooling
+{
+    static MaxPooling create(const PoolWindow&) noexcept
+    {
+        return MaxPooling();
+    }
+
+    PT_INLINE Tensor::Vector vectorInit(const Tensor::Type* inBegin) const noexcept
+    {
+        return simdpp::load_u(inBegin);
+    }
+
+    PT_INLINE Tensor::Vector vectorReduce(const Tensor::Vector& result, const Tensor::Vector& value) const noexcept
+    {
+        return simdpp::max(result, value);
+    }
+
+    PT_INLINE Tensor::Vector vectorResult(const Tensor::Vector& result) const noexcept
+    {
+        return result;
+    }
+
+    PT_INLINE Tensor::Type scalarInit(const Tensor::Type* inBegin) const noexcept
+    {
+        return *inBegin;
+    }
+
+    PT_INLINE Tensor::Type scalarReduce(Tensor::Type result, Tensor::Type value) const noexcept
+    {
+        return std::max(result, value);
+    }
+
+    PT_INLINE Tensor::Type scalarResult(Tensor::Type result) const noexcept
+    {
+        return result;
+    }
+};
+
+
+struct AveragePooling
+{
+    Tensor::Type scale;
+
+    // Same as TensorFlow, padding is not counted:
+    static AveragePooling create(const PoolWindow& window) noexcept
+    {
+        return AveragePooling{ Tensor::Type(1) / (window.rows * window.cols) };
+    }
+
+    PT_INLINE Tensor::Vector vectorInit(const Tensor::Type*) const noexcept
+    {
+        return simdpp::make_zero();
+    }
+
+    PT_INLINE Tensor::Vector vectorReduce(const Tensor::Vector& result, const Tensor::Vector& value) const noexcept
+    {
+        return simdpp::add(result, value);
+    }
+
+    PT_INLINE Tensor::Vector vectorResult(const Tensor::Vector& result) const noexcept
+    {
+        Tensor::Vector scaleVector = simdpp::splat(scale);
+        return simdpp::mul(result, scaleVector);
+    }
+
+    PT_INLINE Tensor::Type scalarInit(const Tensor::Type*) const noexcept
+    {
+        return 0;
+    }
+
+    PT_INLINE Tensor::Type scalarReduce(Tensor::Type result, Tensor::Type value) const noexcept
+    {
+        return result + value;
+    }
+
+    PT_INLINE Tensor::Type scalarResult(Tensor::Type result) const noexcept
+    {
+        return result * scale;
+    }
+};
+
+
+// Vectors use unaligned loads, so any channel can start a vector:
+template<int Vectors, class Pooling>
+PT_INLINE void vectorPool(const Tensor::Type* inBegin, const PoolWindow& window, const Pooling& pooling,
+                          Tensor::Type* outBegin) noexcept
+{
+    Tensor::Vector result[Vectors];
+
+    for(int vector = 0; vector != Vectors; ++vector)
+    {
+        result[vector] = pooling.vectorInit(inBegin + vector * Tensor::VectorSize);
+    }
+
+    for(int row = 0; row != window.rows; ++row)
+    {
+        auto inIt = inBegin + row * window.inIncY;
+
+        for(int col = 0; col != window.cols; ++col)
+        {
+            for(int vector = 0; vector != Vectors; ++vector)
+            {
+                Tensor::Vector value = simdpp::load_u(inIt + vector * Tensor::VectorSize);
+                result[vector] = pooling.vectorReduce(result[vector], value);
+            }
+
+            inIt += window.inIncX;
+        }
+    }
+
+    for(int vector = 0; vector != Vectors; ++vector)
+    {
+        simdpp::store_u(outBegin + vector * Tensor::VectorSize, pooling.vectorResult(result[vector]));
+    }
+}
+
+template<class Pooling>
+void scalarPool(const Tensor::Type* inBegin, const PoolWindow& window, const Pooling& pooling,
+                Tensor::Type* outBegin, int size) noexcept
+{
+    for(int channel = 0; channel != size; ++channel)
+    {
+        auto result = pooling.scalarInit(inBegin + channel);
+
+        for(int row = 0; row != window.rows; ++row)
+        {
+            for(int col = 0; col != window.cols; ++col)
+            {
+                result = pooling.scalarReduce(result, inBegin[row * window.inIncY + col * window.inIncX + channel]);
+            }
+        }
+
+        outBegin[channel] = pooling.scalarResult(result);
+    }
+}
+
+// Pools [0, size) channels of the window pixels. Each output value is computed in registers and stored once.
+// The last vector overlaps the previous one if the channels count is not a multiple of the vector size:
+template<class Pooling>
+void poolChannels(const Tensor::Type* inBegin, const PoolWindow& window, Tensor::Type* outBegin, int size) noexcept
+{
+    auto pooling = Pooling::create(window);
+
+    if(size < int(Tensor::VectorSize))
+    {
+        scalarPool(inBegin, window, pooling, outBegin, size);
+        return;
+    }
+
+    int channel = 0;
+
+    if(PT_LOOP_UNROLLING_ENABLE)
+    {
+        for(; channel + int(Tensor::VectorSize) * 2 <= size; channel += Tensor::VectorSize * 2)
+        {
+            vectorPool<2>(inBegin + channel, window, pooling, outBegin + channel);
+        }
+    }
+
+    for(; channel + int(Tensor::VectorSize) <= size; channel += Tensor::VectorSize)
+    {
+        vectorPool<1>(inBegin + channel, window, pooling, outBegin + channel);
+    }
+
+    if(channel != size)
+    {
+        channel = size - int(Tensor::VectorSize);
+        vectorPool<1>(inBegin + channel, window, pooling, outBegin + channel);
+    }
+}
+
+// Pools all the input pixels into one value per channel (the last input dim).
+// Channel blocks are split across threads, so each output value is computed by only one task
+// and results don't depend on the threads count:
+template<class Pooling>
+void globalPoolChannels(LayerData& layerData)
+{
+    struct Task
+    {
+        LayerData* layerData;
+        int threads;
+        int taskId;
+
+        void operator()() noexcept
+        {
+            const Tensor& in = layerData->in;
+            Tensor& out = layerData->out;
+
+            auto channels = int(in.getDims().back());
+            auto pixels = int(in.getSize()) / channels;
+
+            // Block bounds are multiples of the vector size, and the last task takes the remaining channels:
+            int vectors = channels / int(Tensor::VectorSize);
+            int taskVectors = vectors / threads;
+            int taskExtra = vectors % threads;
+            int channelBegin = (taskVectors * taskId + std::min(taskId, taskExtra)) * int(Tensor::VectorSize);
+            int channelEnd;
+
+            if(taskId == threads - 1)
+            {
+                channelEnd = channels;
+            }
+            else
+            {
+                channelEnd = channelBegin + (taskVectors + (taskId < taskExtra ? 1 : 0)) * int(Tensor::VectorSize);
+            }
+
+            if(channelBegin != channelEnd)
+            {
+                auto outBegin = const_cast<Tensor::Type*>(out.getData().data());
+                PoolWindow window{ 1, pixels, 0, channels };
+                poolChannels<Pooling>(in.getData().data() + channelBegin, window, outBegin + channelBegin,
+                                      channelEnd - channelBegin);
+            }
+        }
+    };
+
+    std::array<Task, PT_MAX_CPU_THREADS> tasks;
+    Dispatcher& dispatcher = layerData.dispatcher;
+    auto threads = int(dispatcher.threads());
+
+    for(int taskId = 0; taskId != threads; ++taskId)
+    {
+        Task& task = tasks[std::size_t(taskId)];
+        task = Task{ &layerData, threads, taskId };
+        dispatcher.add([&task]{ task(); });
+    }
+
+    dispatcher.join();
+}
+
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_pooling_2d_layer.h"
+
+#include <algorithm>
+#include "pt_parser.h"
+#include "pt_layer_data.h"
+
+namespace pt
+{
+
+bool Pooling2DLayer::_parse(std::istream& stream, Params& params)
+{
+    unsigned int poolSizeY = 0;
+
+    if(! Parser::parse(stream, poolSizeY))
+    {
+        PT_LOG_ERROR << "Pool size Y parse failed" << std::endl;
+        return false;
+    }
+
+    unsigned int poolSizeX = 0;
+
+    if(! Parser::parse(stream, poolSizeX))
+    {
+        PT_LOG_ERROR << "Pool size X parse failed" << std::endl;
+        return false;
+    }
+
+    if(poolSizeY == 0 || poolSizeX == 0)
+    {
+        PT_LOG_ERROR << "Invalid pool size: " << poolSizeY << ", " << poolSizeX << std::endl;
+        return false;
+    }
+
+    unsigned int strideY = 0;
+    unsigned int strideX = 0;
+
+    if(! Parser::parse(stream, strideY) || ! Parser::parse(stream, strideX))
+    {
+        PT_LOG_ERROR << "Strides parse failed" << std::endl;
+        return false;
+    }
+
+    if(strideY == 0 || strideX == 0)
+    {
+        PT_LOG_ERROR << "Invalid strides: " << strideY << ", " << strideX << std::endl;
+        return false;
+    }
+
+    unsigned int samePadding = 0;
+
+    if(! Parser::parse(stream, samePadding))
+    {
+        PT_LOG_ERROR << "Padding parse failed" << std::endl;
+        return false;
+    }
+
+    params = Params{ int(poolSizeY), int(poolSizeX), int(strideY), int(strideX), samePadding != 0 };
+    return true;
+}
+
+bool Pooling2DLayer::apply(LayerData& layerData) const
+{
+    Geometry geometry;
+
+    if(! _geometry(layerData.in.getDims(), geometry))
+    {
+        return false;
+    }
+
+    _apply(layerData, geometry);
+    return true;
+}
+
+bool Pooling2DLayer::getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const
+{
+    Geometry geometry;
+
+    if(! _geometry(inDims, geometry))
+    {
+        return false;
+    }
+
+    outDims = { std::size_t(geometry.outY), std::size_t(geometry.outX), inDims[2] };
+    return true;
+}
+
+SpatialLayer::Region Pooling2DLayer::getInputRegion(const Tensor::DimsVector& inDims,
+                                                    const Region& outRegion) const noexcept
+{
+    Geometry geometry;
+    _geometry(inDims, geometry);
+
+    int yBegin = std::max(outRegion.y * _strideY - geometry.padTop, 0);
+    int xBegin = std::max(outRegion.x * _strideX - geometry.padLeft, 0);
+    int yEnd = (outRegion.y + outRegion.rows - 1) * _strideY - geometry.padTop + _poolSizeY;
+    int xEnd = (outRegion.x + outRegion.cols - 1) * _strideX - geometry.padLeft + _poolSizeX;
+    yEnd = std::min(yEnd, int(inDims[0]));
+    xEnd = std::min(xEnd, int(inDims[1]));
+    return Region{ yBegin, xBegin, yEnd - yBegin, xEnd - xBegin };
+}
+
+bool Pooling2DLayer::applyTile(LayerData& layerData, const Tensor::DimsVector& inDims, const Region& inRegion,
+                               const Region& outRegion) const
+{
+    // The input tile covers all the valid window pixels of the output tile, so pixels outside of it are padding:
+    Geometry geometry;
+    _geometry(inDims, geometry);
+
+    geometry.outY = outRegion.rows;
+    geometry.outX = outRegion.cols;
+    geometry.padTop += inRegion.y - outRegion.y * _strideY;
+    geometry.padLeft += inRegion.x - outRegion.x * _strideX;
+    _apply(layerData, geometry);
+    return true;
+}
+
+bool Pooling2DLayer::_geometry(const Tensor::DimsVector& inDims, Geometry& geometry) const
+{
+    const auto& iw = inDims;
+
+    if(iw.size() != 3)
+    {
+        PT_LOG_ERROR << "Input tensor dims count must be 3" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" << std::endl;
+        return false;
+    }
+
+    auto rows = int(iw[0]);
+    auto cols = int(iw[1]);
+
+    if(_samePadding)
+    {
+        // Same as TensorFlow, extra padding goes to the bottom and right sides:
+        geometry.outY = (rows + _strideY - 1) / _strideY;
+        geometry.outX = (cols + _strideX - 1) / _strideX;
+        geometry.padTop = std::max((geometry.outY - 1) * _strideY + _poolSizeY - rows, 0) / 2;
+        geometry.padLeft = std::max((geometry.outX - 1) * _strideX + _poolSizeX - cols, 0) / 2;
+    }
+    else
+    {
+        if(rows < _poolSizeY || cols < _poolSizeX)
+        {
+            PT_LOG_ERROR << "Input tensor is smaller than the pool size" <<
+                                " (input dims: " << VectorPrinter<std::size_t>{ iw } << ")" <<
+                                " (pool size: " << _poolSizeY << ", " << _poolSizeX << ")" << std::endl;
+            return false;
+        }
+
+        // Incomplete windows are dropped:
+        geometry.outY = (rows - _poolSizeY) / _strideY + 1;
+        geometry.outX = (cols - _poolSizeX) / _strideX + 1;
+        geometry.padTop = 0;
+        geometry.padLeft = 0;
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,73 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_POOLING_2D_LAYER_H
+#define PT_POOLING_2D_LAYER_H
+
+#include "pt_spatial_layer.h"
+
+namespace pt
+{
+
+class Pooling2DLayer : public SpatialLayer
+{
+
+public:
+    bool apply(LayerData& layerData) const final;
+
+    bool getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const final;
+
+    Region getInputRegion(const Tensor::DimsVector& inDims, const Region& outRegion) const noexcept final;
+
+    bool applyTile(LayerData& layerData, const Tensor::DimsVector& inDims, const Region& inRegion,
+                   const Region& outRegion) const final;
+
+protected:
+    struct Params
+    {
+        int poolSizeY;
+        int poolSizeX;
+        int strideY;
+        int strideX;
+        bool samePadding;
+    };
+
+    struct Geometry
+    {
+        int outY;
+        int outX;
+        int padTop;
+        int padLeft;
+    };
+
+    int _poolSizeY;
+    int _poolSizeX;
+    int _strideY;
+    int _strideX;
+    bool _samePadding;
+
+    // Parses pool size, strides and padding:
+    static bool _parse(std::istream& stream, Params& params);
+
+    explicit Pooling2DLayer(const Params& params) noexcept :
+        _poolSizeY(params.poolSizeY),
+        _poolSizeX(params.poolSizeX),
+        _strideY(params.strideY),
+        _strideX(params.strideX),
+        _samePadding(params.samePadding)
+    {
+    }
+
+    bool _geometry(const Tensor::DimsVector& inDims, Geometry& geometry) const;
+
+    // Window pixels outside of the input (padding) are skipped:
+    virtual void _apply(LayerData& layerData, const Geometry& geometry) const = 0;
+};
+
+}
+
+#endif
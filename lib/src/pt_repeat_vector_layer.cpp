@@ -7,6 +7,7 @@
 
 #include "pt_repeat_vector_layer.h"
 
+#include <algorithm>
 #include "pt_parser.h"
 #include "pt_layer_data.h"
 
@@ -34,7 +35,18 @@ std::unique_ptr<RepeatVectorLayer> RepeatVectorLayer::create(std::istream& strea
 
 bool RepeatVectorLayer::apply(LayerData& layerData) const
 {
-    layerData.in.repeat(_n, 1, layerData.out);
+    // Input values are copied as the rows of a (n, input size) tensor:
+    const Tensor& in = layerData.in;
+    Tensor& out = layerData.out;
+    out.resize(std::size_t(_n), in.getSize());
+
+    auto outIt = out.begin();
+
+    for(int index = 0; index != _n; ++index)
+    {
+        outIt = std::copy(in.begin(), in.end(), outIt);
+    }
+
     return true;
 }
 
@@ -22,6 +22,8 @@ public:
     bool apply(LayerData& layerData) const final;
 
 protected:
+    friend class RepeatVectorLstmLayer;
+
     int _n;
 
     explicit RepeatVectorLayer(int n) noexcept;
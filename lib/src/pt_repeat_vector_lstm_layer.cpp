@@ -0,0 +1,94 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_repeat_vector_lstm_layer.h"
+
+#include "pt_config.h"
+#include "pt_layer_data.h"
+#include "pt_logger.h"
+
+namespace pt
+{
+
+namespace
+{
+    template<class LayerType>
+    std::unique_ptr<LayerType> castLayer(std::unique_ptr<Layer>& layer)
+    {
+        return std::unique_ptr<LayerType>(static_cast<LayerType*>(layer.release()));
+    }
+}
+
+void RepeatVectorLstmLayer::fuse(std::vector<std::unique_ptr<Layer>>& layers)
+{
+    std::vector<std::unique_ptr<Layer>> fusedLayers;
+    std::size_t layersCount = layers.size();
+    std::size_t index = 0;
+
+    while(index != layersCount)
+    {
+        auto repeatVector = dynamic_cast<const RepeatVectorLayer*>(layers[index].get());
+        auto lstm = index + 1 != layersCount ? dynamic_cast<const LstmLayer*>(layers[index + 1].get()) : nullptr;
+
+        if(repeatVector && lstm)
+        {
+            fusedLayers.push_back(std::unique_ptr<Layer>(new RepeatVectorLstmLayer(
+                                      castLayer<RepeatVectorLayer>(layers[index]),
+                                      castLayer<LstmLayer>(layers[index + 1]))));
+            index += 2;
+            continue;
+        }
+
+        fusedLayers.push_back(std::move(layers[index]));
+        ++index;
+    }
+
+    layers = std::move(fusedLayers);
+}
+
+bool RepeatVectorLstmLayer::apply(LayerData& layerData) const
+{
+    // LSTM prefix cache hashes LSTM input values, so original layers are run if it is enabled:
+    const Config& config = layerData.config;
+
+    if(! config.getLayerFusion() || (config.getLstmPrefixCache() && ! layerData.state))
+    {
+        if(! _repeatVector->apply(layerData))
+        {
+            return false;
+        }
+
+        layerData.in = std::move(layerData.out);
+        return _lstm->apply(layerData);
+    }
+
+    Tensor& in = layerData.in;
+    const auto& ww = _lstm->_w.getDims();
+
+    if(in.getSize() != ww[1])
+    {
+        PT_LOG_ERROR << "Input tensor size must be the same as w dims[1]" <<
+                            " (input dims: " << VectorPrinter<std::size_t>{ in.getDims() } << ")" <<
+                            " (w dims: " << VectorPrinter<std::size_t>{ ww } << ")" << std::endl;
+        return false;
+    }
+
+    // All steps have the same input, so its projection is computed once and shared by all of them:
+    Tensor xw;
+    in.resize(1, ww[1]);
+    in.dot(_lstm->_w, xw, layerData.dispatcher);
+    return _lstm->_apply(layerData, std::size_t(_repeatVector->_n), &xw, 0);
+}
+
+RepeatVectorLstmLayer::RepeatVectorLstmLayer(std::unique_ptr<RepeatVectorLayer>&& repeatVector,
+                                             std::unique_ptr<LstmLayer>&& lstm) noexcept :
+    _repeatVector(std::move(repeatVector)),
+    _lstm(std::move(lstm))
+{
+}
+
+}
@@ -0,0 +1,37 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_REPEAT_VECTOR_LSTM_LAYER_H
+#define PT_REPEAT_VECTOR_LSTM_LAYER_H
+
+#include <vector>
+#include "pt_repeat_vector_layer.h"
+#include "pt_lstm_layer.h"
+
+namespace pt
+{
+
+class RepeatVectorLstmLayer : public Layer
+{
+
+public:
+    // Replaces RepeatVector -> LSTM sequences with fused layers:
+    static void fuse(std::vector<std::unique_ptr<Layer>>& layers);
+
+    bool apply(LayerData& layerData) const final;
+
+protected:
+    std::unique_ptr<RepeatVectorLayer> _repeatVector;
+    std::unique_ptr<LstmLayer> _lstm;
+
+    RepeatVectorLstmLayer(std::unique_ptr<RepeatVectorLayer>&& repeatVector,
+                          std::unique_ptr<LstmLayer>&& lstm) noexcept;
+};
+
+}
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#include "pt_separable_conv_2d_layer.h"
+
+#include <array>
+#include <algorithm>
+#include "pt_dispatcher.h"
+#include "pt_layer_data.h"
+#include "pt_multiply_add.h"
+#include "pt_output_tiles.h"
+#include "pt_logger.h"
+
+namespace pt
+{
+
+namespace
+{
+    // Output pixels computed at once, so the depthwise output stays in cache for the pointwise stage:
+    constexpr int chunkPixels = 16;
+
+    constexpr int tilePixels = 4;
+
+    // Pointwise 1x1 GEMM: a tile of pixels times a block of output channels is accumulated in registers:
+    template<int Pixels, int Vectors>
+    PT_INLINE void pointwiseTile(const Tensor::Type* inBegin, const Tensor::Type* wBegin, const Tensor::Type* bBegin,
+                                 Tensor::Type* outBegin, int channels, int filters) noexcept
+    {
+        for(int filter = 0; filter != filters; filter += Tensor::VectorSize * Vectors)
+        {
+            Tensor::Vector acc[Pixels][Vectors];
+
+            for(int vector = 0; vector != Vectors; ++vector)
+            {
+                Tensor::Vector bias = simdpp::load(bBegin + filter + vector * Tensor::VectorSize);
+
+                for(int pixel = 0; pixel != Pixels; ++pixel)
+                {
+                    acc[pixel][vector] = bias;
+                }
+            }
+
+            auto wIt = wBegin + filter;
+
+            for(int channel = 0; channel != channels; ++channel)
+            {
+                Tensor::Vector w[Vectors];
+
+                for(int vector = 0; vector != Vectors; ++vector)
+                {
+                    w[vector] = simdpp::load(wIt + vector * Tensor::VectorSize);
+                }
+
+                for(int pixel = 0; pixel != Pixels; ++pixel)
+                {
+                    Tensor::Vector value = simdpp::splat(inBegin[pixel * channels + channel]);
+
+                    for(int vector = 0; vector != Vectors; ++vector)
+                    {
+                        acc[pixel][vector] = detail::madd(value, w[vector], acc[pixel][vector]);
+                    }
+                }
+
+                wIt += filters;
+            }
+
+            for(int pixel = 0; pixel != Pixels; ++pixel)
+            {
+                for(int vector = 0; vector != Vectors; ++vector)
+                {
+                    simdpp::store(outBegin + pixel * filters + filter + vector * Tensor::VectorSize,
+                                  acc[pixel][vector]);
+                }
+            }
+        }
+    }
+
+    template<int Vectors>
+    void vectorPointwise(const Tensor::Type* inBegin, const Tensor::Type* wBegin, const Tensor::Type* bBegin,
+                         Tensor::Type* outBegin, int pixels, int channels, int filters) noexcept
+    {
+        int pixel = 0;
+
+        for(; pixel + tilePixels <= pixels; pixel += tilePixels)
+        {
+            pointwiseTile<tilePixels, Vectors>(inBegin + pixel * channels, wBegin, bBegin,
+                                               outBegin + pixel * filters, channels, filters);
+        }
+
+        for(; pixel != pixels; ++pixel)
+        {
+            pointwiseTile<1, Vectors>(inBegin + pixel * channels, wBegin, bBegin, outBegin + pixel * filters,
+                                      channels, filters);
+        }
+    }
+
+    void scalarPointwise(const Tensor::Type* inBegin, const Tensor::Type* wBegin, const Tensor::Type* bBegin,
+                         Tensor::Type* outBegin, int pixels, int channels, int filters) noexcept
+    {
+        for(int pixel = 0; pixel != pixels; ++pixel)
+        {
+            auto inIt = inBegin + pixel * channels;
+            auto outIt = outBegin + pixel * filters;
+            std::copy(bBegin, bBegin + filters, outIt);
+
+            for(int channel = 0; channel != channels; ++channel)
+            {
+                auto value = inIt[channel];
+                auto wIt = wBegin + channel * filters;
+
+                for(int filter = 0; filter != filters; ++filter)
+                {
+                    outIt[filter] += value * wIt[filter];
+                }
+            }
+        }
+    }
+}
+
+std::unique_ptr<SeparableConv2DLayer> SeparableConv2DLayer::create(std::istream& stream)
+{
+    auto depthwise = DepthwiseConv2DLayer::_create(stream);
+
+    if(! depthwise)
+    {
+        PT_LOG_ERROR << "Depthwise layer parse failed" << std::endl;
+        return nullptr;
+    }
+
+    auto pointwiseWeights = Tensor::create(2, stream);
+
+    if(! pointwiseWeights)
+    {
+        PT_LOG_ERROR << "Pointwise weights tensor parse failed" << std::endl;
+        return nullptr;
+    }
+
+    const auto& pw = pointwiseWeights->getDims();
+
+    if(pw[0] != depthwise->_weights.getDims()[2])
+    {
+        PT_LOG_ERROR << "Pointwise weights dims[0] must be the same as depthwise weights dims[2]" <<
+                            " (pointwise weights dims: " << VectorPrinter<std::size_t>{ pw } << ")" <<
+                            " (depthwise weights dims: " <<
+                            VectorPrinter<std::size_t>{ depthwise->_weights.getDims() } << ")" << std::endl;
+        return nullptr;
+    }
+
+    auto biases = Tensor::create(1, stream);
+
+    if(! biases)
+    {
+        PT_LOG_ERROR << "Biases tensor parse failed" << std::endl;
+        return nullptr;
+    }
+
+    if(biases->getSize() != pw[1])
+    {
+        PT_LOG_ERROR << "Invalid biases tensor dims" <<
+                            " (biases dims: " << VectorPrinter<std::size_t>{ biases->getDims() } << ")" <<
+                            " (pointwise weights dims: " << VectorPrinter<std::size_t>{ pw } << ")" << std::endl;
+        return nullptr;
+    }
+
+    auto activation = ActivationLayer::create(stream);
+
+    if(! activation)
+    {
+        PT_LOG_ERROR << "Activation layer parse failed" << std::endl;
+        return nullptr;
+    }
+
+    return std::unique_ptr<SeparableConv2DLayer>(new SeparableConv2DLayer(std::move(depthwise),
+                                                                          std::move(*pointwiseWeights),
+                                                                          std::move(*biases),
+                                                                          std::move(activation)));
+}
+
+bool SeparableConv2DLayer::apply(LayerData& layerData) const
+{
+    // Both stages run on chunks of output pixels, so the intermediate tensor is never fully stored:
+    struct Task
+    {
+        const SeparableConv2DLayer* layer;
+        const DepthwiseConv2DLayer::Geometry* geometry;
+        const OutputTiles* tiles;
+        LayerData* layerData;
+        int taskId;
+
+        void operator()()
+        {
+            const DepthwiseConv2DLayer& depthwise = *layer->_depthwise;
+            Tensor& out = layerData->out;
+            auto channels = int(layer->_pointwiseWeights.getDims()[0]);
+            auto filters = int(layer->_pointwiseWeights.getDims()[1]);
+            auto outBegin = &*out.begin();
+            auto wBegin = layer->_pointwiseWeights.getData().data();
+            auto bBegin = layer->_biases.getData().data();
+
+            Tensor chunk(std::size_t(chunkPixels * channels));
+            auto chunkBegin = &*chunk.begin();
+
+            for(int index = tiles->taskBegin(taskId), end = tiles->taskEnd(taskId); index != end; ++index)
+            {
+                OutputTiles::Tile tile = tiles->tile(index);
+
+                for(int x = tile.colBegin; x < tile.colEnd; x += chunkPixels)
+                {
+                    int pixels = std::min(chunkPixels, tile.colEnd - x);
+                    auto outIt = outBegin + (tile.row * geometry->outX + x) * filters;
+                    depthwise._row(layerData->in, *geometry, tile.row, x, x + pixels, 0, channels, chunkBegin,
+                                   channels);
+
+                    if(PT_LOOP_UNROLLING_ENABLE && filters % (Tensor::VectorSize * 2) == 0)
+                    {
+                        vectorPointwise<2>(chunkBegin, wBegin, bBegin, outIt, pixels, channels, filters);
+                    }
+                    else if(filters % Tensor::VectorSize == 0)
+                    {
+                        vectorPointwise<1>(chunkBegin, wBegin, bBegin, outIt, pixels, channels, filters);
+                    }
+                    else
+                    {
+                        scalarPointwise(chunkBegin, wBegin, bBegin, outIt, pixels, channels, filters);
+                    }
+                }
+            }
+        }
+    };
+
+    DepthwiseConv2DLayer::Geometry geometry;
+
+    if(! _depthwise->_geometry(layerData.in, geometry))
+    {
+        return false;
+    }
+
+    Tensor& out = layerData.out;
+    auto filters = _pointwiseWeights.getDims()[1];
+    out.resize(std::size_t(geometry.outY), std::size_t(geometry.outX), filters);
+
+    // Output channels are not split, since each block would repeat the depthwise stage:
+    std::array<Task, PT_MAX_CPU_THREADS> tasks;
+    Dispatcher& dispatcher = layerData.dispatcher;
+    auto threads = int(dispatcher.threads());
+    OutputTiles tiles{ geometry.outY, geometry.outX, int(filters), tilePixels, int(filters), threads };
+
+    for(int taskId = 0; taskId != threads; ++taskId)
+    {
+        Task& task = tasks[std::size_t(taskId)];
+        task = Task{ this, &geometry, &tiles, &layerData, taskId };
+        dispatcher.add([&task]{ task(); });
+    }
+
+    dispatcher.join();
+
+    _activation->apply(out);
+    return true;
+}
+
+SeparableConv2DLayer::SeparableConv2DLayer(std::unique_ptr<DepthwiseConv2DLayer>&& depthwise,
+                                           Tensor&& pointwiseWeights, Tensor&& biases,
+                                           std::unique_ptr<ActivationLayer>&& activation) noexcept :
+    _depthwise(std::move(depthwise)),
+    _pointwiseWeights(std::move(pointwiseWeights)),
+    _biases(std::move(biases)),
+    _activation(std::move(activation))
+{
+}
+
+}
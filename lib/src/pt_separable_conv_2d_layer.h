@@ -0,0 +1,37 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_SEPARABLE_CONV_2D_LAYER_H
+#define PT_SEPARABLE_CONV_2D_LAYER_H
+
+#include "pt_depthwise_conv_2d_layer.h"
+
+namespace pt
+{
+
+class SeparableConv2DLayer : public Layer
+{
+
+public:
+    static std::unique_ptr<SeparableConv2DLayer> create(std::istream& stream);
+
+    bool apply(LayerData& layerData) const final;
+
+protected:
+    // Pointwise weights are stored as (depth * depth multiplier, outputs):
+    std::unique_ptr<DepthwiseConv2DLayer> _depthwise;
+    Tensor _pointwiseWeights;
+    Tensor _biases;
+    std::unique_ptr<ActivationLayer> _activation;
+
+    SeparableConv2DLayer(std::unique_ptr<DepthwiseConv2DLayer>&& depthwise, Tensor&& pointwiseWeights,
+                         Tensor&& biases, std::unique_ptr<ActivationLayer>&& activation) noexcept;
+};
+
+}
+
+#endif
@@ -8,7 +8,7 @@
 #ifndef PT_SIGMOID_ACTIVATION_LAYER_H
 #define PT_SIGMOID_ACTIVATION_LAYER_H
 
-#include "pt_tensor.h"
+#include "pt_exp.h"
 #include "pt_activation_layer.h"
 
 namespace pt
@@ -24,17 +24,36 @@ public:
 
     void apply(Tensor& out) const final
     {
-        for(FloatType& value : out)
+        auto it = out.begin();
+        auto end = out.end();
+
+        #if PT_VECTOR_EXP_ENABLE
+            Tensor::Vector one = detail::vectorConstant(Tensor::Type(1));
+            Tensor::Vector zero = detail::vectorConstant(Tensor::Type(0));
+            auto vectorEnd = end - long(out.getSize() % Tensor::VectorSize);
+
+            for(; it != vectorEnd; it += Tensor::VectorSize)
+            {
+                auto ptr = &*it;
+                Tensor::Vector v = simdpp::load(ptr);
+                Tensor::Vector z = detail::exp(simdpp::neg(simdpp::abs(v)));
+                Tensor::Vector r = simdpp::div(one, simdpp::add(one, z));
+                simdpp::store(ptr, simdpp::blend(simdpp::mul(z, r), r, simdpp::cmp_lt(v, zero)));
+            }
+        #endif
+
+        // Tail values which don't fill a vector (or all of them without vector exp):
+        for(; it != end; ++it)
         {
-            FloatType z = std::exp(-std::abs(value));
+            FloatType z = std::exp(-std::abs(*it));
 
-            if(value < 0)
+            if(*it < 0)
             {
-                value = z / (FloatType(1) + z);
+                *it = z / (FloatType(1) + z);
             }
             else
             {
-                value = FloatType(1) / (FloatType(1) + z);
+                *it = FloatType(1) / (FloatType(1) + z);
             }
         }
     }
@@ -22,6 +22,12 @@ public:
 
     SoftMaxActivationLayer() = default;
 
+    // Outputs depend on all the inputs:
+    bool isTileable() const noexcept final
+    {
+        return false;
+    }
+
     void apply(Tensor& out) const final
     {
         FloatType d = 0;
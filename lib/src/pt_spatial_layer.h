@@ -0,0 +1,51 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_SPATIAL_LAYER_H
+#define PT_SPATIAL_LAYER_H
+
+#include "pt_tensor.h"
+#include "pt_layer.h"
+
+namespace pt
+{
+
+// Layers with (rows, cols, channels) inputs and outputs which can be applied tile by tile,
+// so sequences of them can be run depth-first without storing full size intermediate tensors:
+class SpatialLayer : public Layer
+{
+
+public:
+    struct Region
+    {
+        int y;
+        int x;
+        int rows;
+        int cols;
+    };
+
+    virtual bool isTileable() const noexcept
+    {
+        return true;
+    }
+
+    virtual bool getOutputDims(const Tensor::DimsVector& inDims, Tensor::DimsVector& outDims) const = 0;
+
+    // Input region needed to compute the given output region, clipped to the input dims:
+    virtual Region getInputRegion(const Tensor::DimsVector& inDims, const Region& outRegion) const noexcept = 0;
+
+    // Computes the given output region from an input tensor holding the given input region:
+    virtual bool applyTile(LayerData& layerData, const Tensor::DimsVector& inDims, const Region& inRegion,
+                           const Region& outRegion) const = 0;
+
+protected:
+    SpatialLayer() = default;
+};
+
+}
+
+#endif
@@ -8,7 +8,7 @@
 #ifndef PT_TANH_ACTIVATION_LAYER_H
 #define PT_TANH_ACTIVATION_LAYER_H
 
-#include "pt_tensor.h"
+#include "pt_exp.h"
 #include "pt_activation_layer.h"
 
 namespace pt
@@ -24,9 +24,43 @@ public:
 
     void apply(Tensor& out) const final
     {
-        for(FloatType& value : out)
+        auto it = out.begin();
+        auto end = out.end();
+
+        #if PT_VECTOR_EXP_ENABLE
+            Tensor::Vector one = detail::vectorConstant(Tensor::Type(1));
+            Tensor::Vector two = detail::vectorConstant(Tensor::Type(2));
+            auto vectorEnd = end - long(out.getSize() % Tensor::VectorSize);
+
+            for(; it != vectorEnd; it += Tensor::VectorSize)
+            {
+                auto ptr = &*it;
+                Tensor::Vector v = simdpp::load(ptr);
+                Tensor::Vector x = simdpp::abs(v);
+
+                // Cephes tanhf polynomial for small values:
+                Tensor::Vector x2 = simdpp::mul(x, x);
+                Tensor::Vector p = detail::vectorConstant(-5.70498872745e-3f);
+                p = simdpp::add(simdpp::mul(p, x2), detail::vectorConstant(2.06390887954e-2f));
+                p = simdpp::add(simdpp::mul(p, x2), detail::vectorConstant(-5.37397155531e-2f));
+                p = simdpp::add(simdpp::mul(p, x2), detail::vectorConstant(1.33314422036e-1f));
+                p = simdpp::add(simdpp::mul(p, x2), detail::vectorConstant(-3.33332819422e-1f));
+                p = simdpp::add(simdpp::mul(simdpp::mul(p, x2), x), x);
+
+                // 1 - 2 / (exp(2x) + 1) otherwise:
+                Tensor::Vector e = detail::exp(simdpp::mul(x, two));
+                Tensor::Vector q = simdpp::sub(one, simdpp::div(two, simdpp::add(e, one)));
+
+                Tensor::Vector r = simdpp::blend(q, p, simdpp::cmp_ge(x, detail::vectorConstant(0.625f)));
+                auto negative = simdpp::cmp_lt(v, detail::vectorConstant(0.0f));
+                simdpp::store(ptr, simdpp::blend(simdpp::neg(r), r, negative));
+            }
+        #endif
+
+        // Tail values which don't fill a vector (or all of them without vector exp):
+        for(; it != end; ++it)
         {
-            value = std::tanh(value);
+            *it = std::tanh(*it);
         }
     }
 };
@@ -0,0 +1,55 @@
+/*
+ * pocket-tensor (c) 2019 Gustavo Valiente gustavo.valiente@protonmail.com
+ * Kerasify (c) 2016 Robert W. Rose
+ *
+ * MIT License, see LICENSE file.
+ */
+
+#ifndef PT_TEMP_DATA_POOL_H
+#define PT_TEMP_DATA_POOL_H
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+namespace pt
+{
+
+// Recurrent layers scratch buffers, reused across apply calls (one per concurrent caller).
+// TempData is constructed from the layer units count:
+template<class TempData>
+class TempDataPool
+{
+
+public:
+    std::unique_ptr<TempData> acquire(std::size_t units)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            if(! _pool.empty())
+            {
+                auto tempData = std::move(_pool.back());
+                _pool.pop_back();
+                return tempData;
+            }
+        }
+
+        return std::unique_ptr<TempData>(new TempData(units));
+    }
+
+    void release(std::unique_ptr<TempData>&& tempData)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pool.push_back(std::move(tempData));
+    }
+
+protected:
+    std::mutex _mutex;
+    std::vector<std::unique_ptr<TempData>> _pool;
+};
+
+}
+
+#endif
@@ -8,7 +8,9 @@
 #include "pt_tensor.h"
 
 #include <array>
+#include <algorithm>
 #include <numeric>
+#include <functional>
 #include "pt_add.h"
 #include "pt_multiply.h"
 #include "pt_multiply_add.h"
@@ -20,96 +22,170 @@ namespace pt
 
 namespace
 {
-    template<class AddType>
-    void addImpl(const Tensor& in, Tensor& out, Dispatcher& dispatcher)
+    // Min values per task to split elementwise operations across threads:
+    constexpr std::size_t minTaskSize = 4096;
+
+    // Operand dims must be the same as the last input dims, ignoring leading dims of size 1 (NumPy broadcasting).
+    // Empty operands are rejected, since they have nothing to repeat:
+    bool isBroadcastable(const Tensor::DimsVector& dims, const Tensor::DimsVector& operandDims) noexcept
     {
-        struct Task
+        if(operandDims.empty())
         {
-            const Tensor* in;
-            Tensor* out;
-            int threads;
-            int taskId;
+            return false;
+        }
 
-            void operator()() noexcept
-            {
-                auto its = int(in->getSize());
-                auto taskIts = its / threads;
-                auto taskBegin = taskIts * taskId;
-                int taskEnd;
+        auto operandIt = operandDims.begin();
 
-                if(taskId == threads - 1)
-                {
-                    taskEnd = its;
-                }
-                else
-                {
-                    taskEnd = taskBegin + taskIts;
-                }
+        while(operandIt != operandDims.end() && *operandIt == 1 && operandDims.end() - operandIt > 1)
+        {
+            ++operandIt;
+        }
 
-                auto inBegin = in->begin() + taskBegin;
-                auto outBegin = out->begin() + taskBegin;
-                AddType()(&*inBegin, &*outBegin, taskEnd - taskBegin);
-            }
-        };
+        auto operandSize = std::size_t(operandDims.end() - operandIt);
+        return operandSize <= dims.size() && std::equal(operandIt, operandDims.end(), dims.end() - operandSize);
+    }
 
-        std::array<Task, PT_MAX_CPU_THREADS> tasks;
-        auto threads = int(dispatcher.threads());
+    // Vectorized operations need aligned operand rows (or a single operand row of the input size):
+    int vectorStep(std::size_t size, std::size_t operandSize) noexcept
+    {
+        auto vectorSize = std::size_t(Tensor::VectorSize);
 
-        for(int taskId = 0; taskId != threads; ++taskId)
+        if(operandSize != size && operandSize % vectorSize)
         {
-            Task& task = tasks[std::size_t(taskId)];
-            task = Task{ &in, &out, threads, taskId };
-            dispatcher.add([&task]{ task(); });
+            return 1;
         }
 
-        dispatcher.join();
+        if(PT_LOOP_UNROLLING_ENABLE && (operandSize == size || operandSize % (vectorSize * 2) == 0))
+        {
+            return Tensor::VectorSize * 2;
+        }
+
+        return Tensor::VectorSize;
     }
 
-    template<class MultiplyType>
-    void multiplyImpl(const Tensor& in, Tensor& out, Dispatcher& dispatcher)
+    // Elementwise operations are applied on chunks which don't cross operand rows.
+    // Vectorized operations process whole vectors, and the remaining values are processed with scalar ones:
+    template<class OperationType, class ScalarOperationType, int Step>
+    struct BinaryOperation
+    {
+        const Tensor::Type* a;
+        const Tensor::Type* b;
+        Tensor::Type* r;
+
+        void operator()(std::size_t index, std::size_t operandIndex, std::size_t length) const noexcept
+        {
+            auto vectorLength = length - length % Step;
+            OperationType()(a + index, b + operandIndex, r + index, int(vectorLength));
+
+            index += vectorLength;
+            operandIndex += vectorLength;
+            ScalarOperationType()(a + index, b + operandIndex, r + index, int(length - vectorLength));
+        }
+    };
+
+    template<class OperationType, class ScalarOperationType, int Step>
+    struct TernaryOperation
+    {
+        const Tensor::Type* a;
+        const Tensor::Type* b;
+        const Tensor::Type* c;
+        Tensor::Type* r;
+
+        void operator()(std::size_t index, std::size_t operandIndex, std::size_t length) const noexcept
+        {
+            auto vectorLength = length - length % Step;
+            OperationType()(a + index, b + operandIndex, c + operandIndex, r + index, int(vectorLength));
+
+            index += vectorLength;
+            operandIndex += vectorLength;
+            ScalarOperationType()(a + index, b + operandIndex, c + operandIndex, r + index,
+                                  int(length - vectorLength));
+        }
+    };
+
+    template<class OperationType>
+    void elementwiseImpl(const OperationType& operation, std::size_t size, std::size_t operandSize,
+                         Dispatcher& dispatcher)
     {
         struct Task
         {
-            const Tensor* in;
-            Tensor* out;
-            int threads;
-            int taskId;
+            const OperationType* operation;
+            std::size_t size;
+            std::size_t operandSize;
+            std::size_t threads;
+            std::size_t taskId;
 
             void operator()() noexcept
             {
-                auto its = int(in->getSize());
-                auto taskIts = its / threads;
-                auto taskBegin = taskIts * taskId;
-                int taskEnd;
+                // Task bounds are multiples of two vectors, so vectorized operations stay aligned:
+                auto blockSize = std::size_t(Tensor::VectorSize * 2);
+                auto taskSize = size / blockSize / threads * blockSize;
+                auto taskBegin = taskSize * taskId;
+                std::size_t taskEnd;
 
                 if(taskId == threads - 1)
                 {
-                    taskEnd = its;
+                    taskEnd = size;
                 }
                 else
                 {
-                    taskEnd = taskBegin + taskIts;
+                    taskEnd = taskBegin + taskSize;
                 }
 
-                auto inBegin = in->begin() + taskBegin;
-                auto outBegin = out->begin() + taskBegin;
-                MultiplyType()(&*inBegin, &*outBegin, taskEnd - taskBegin);
+                auto operandIndex = taskBegin % operandSize;
+
+                for(auto index = taskBegin; index != taskEnd; )
+                {
+                    auto length = std::min(operandSize - operandIndex, taskEnd - index);
+                    (*operation)(index, operandIndex, length);
+                    index += length;
+                    operandIndex = 0;
+                }
             }
         };
 
         std::array<Task, PT_MAX_CPU_THREADS> tasks;
-        auto threads = int(dispatcher.threads());
+        auto threads = std::min(dispatcher.threads(), std::max(size / minTaskSize, std::size_t(1)));
 
-        for(int taskId = 0; taskId != threads; ++taskId)
+        for(std::size_t taskId = 0; taskId != threads; ++taskId)
         {
-            Task& task = tasks[std::size_t(taskId)];
-            task = Task{ &in, &out, threads, taskId };
+            Task& task = tasks[taskId];
+            task = Task{ &operation, size, operandSize, threads, taskId };
             dispatcher.add([&task]{ task(); });
         }
 
         dispatcher.join();
     }
 
+    template<class Vector2Type, class VectorType, class ScalarType>
+    void binaryImpl(const Tensor& a, const Tensor& b, Tensor& out, Dispatcher& dispatcher)
+    {
+        auto size = a.getSize();
+        auto operandSize = b.getSize();
+        auto aBegin = a.getData().data();
+        auto bBegin = b.getData().data();
+        auto outBegin = &*out.begin();
+
+        switch(vectorStep(size, operandSize))
+        {
+
+        case Tensor::VectorSize * 2:
+            elementwiseImpl(BinaryOperation<Vector2Type, ScalarType, Tensor::VectorSize * 2>{
+                                aBegin, bBegin, outBegin }, size, operandSize, dispatcher);
+            break;
+
+        case Tensor::VectorSize:
+            elementwiseImpl(BinaryOperation<VectorType, ScalarType, Tensor::VectorSize>{
+                                aBegin, bBegin, outBegin }, size, operandSize, dispatcher);
+            break;
+
+        default:
+            elementwiseImpl(BinaryOperation<ScalarType, ScalarType, 1>{
+                                aBegin, bBegin, outBegin }, size, operandSize, dispatcher);
+            break;
+        }
+    }
+
     template<class MultiplyAddType>
     void dotImpl(const Tensor& a, const Tensor& b, Tensor& out, Dispatcher& dispatcher)
     {
@@ -173,65 +249,17 @@ namespace
 
         dispatcher.join();
     }
-
-    template<class MultiplyAddType>
-    void multiplyAddImpl(const Tensor& scale, const Tensor& in, Tensor& out, Dispatcher& dispatcher)
-    {
-        struct Task
-        {
-            const Tensor* scale;
-            const Tensor* in;
-            Tensor* out;
-            int threads;
-            int taskId;
-
-            void operator()() noexcept
-            {
-                auto its = int(in->getSize());
-                auto taskIts = its / threads;
-                auto taskBegin = taskIts * taskId;
-                int taskEnd;
-
-                if(taskId == threads - 1)
-                {
-                    taskEnd = its;
-                }
-                else
-                {
-                    taskEnd = taskBegin + taskIts;
-                }
-
-                auto inBegin = in->begin() + taskBegin;
-                auto scaleBegin = scale->begin() + taskBegin;
-                auto outBegin = out->begin() + taskBegin;
-                MultiplyAddType()(&*inBegin, &*scaleBegin, &*outBegin, taskEnd - taskBegin);
-            }
-        };
-
-        std::array<Task, PT_MAX_CPU_THREADS> tasks;
-        auto threads = int(dispatcher.threads());
-
-        for(int taskId = 0; taskId != threads; ++taskId)
-        {
-            Task& task = tasks[std::size_t(taskId)];
-            task = Task{ &scale, &in, &out, threads, taskId };
-            dispatcher.add([&task]{ task(); });
-        }
-
-        dispatcher.join();
-    }
 }
 
 std::unique_ptr<Tensor> Tensor::create(std::size_t dims, std::istream& stream)
 {
-    if(dims == 0)
+    if(dims == 0 || dims > DimsVector::MaxSize)
     {
         PT_LOG_ERROR << "Invalid dims value: " << dims << std::endl;
         return nullptr;
     }
 
     std::unique_ptr<Tensor> tensor(new Tensor());
-    tensor->_dims.reserve(dims);
 
     for(std::size_t i = 0; i != dims; ++i)
     {
@@ -252,7 +280,12 @@ std::unique_ptr<Tensor> Tensor::create(std::size_t dims, std::istream& stream)
         tensor->_dims.push_back(stride);
     }
 
-    std::size_t size = tensor->getSize();
+    std::size_t size = 1;
+
+    for(auto dim : tensor->_dims)
+    {
+        size *= dim;
+    }
 
     #if PT_DOUBLE_ENABLE
         std::vector<float> data(size);
@@ -281,28 +314,9 @@ std::unique_ptr<Tensor> Tensor::create(std::size_t dims, std::istream& stream)
     return tensor;
 }
 
-std::size_t Tensor::getSize() const noexcept
-{
-    std::size_t size = 0;
-
-    if(! _dims.empty())
-    {
-        ++size;
-
-        for(auto dim : _dims)
-        {
-            size *= dim;
-        }
-    }
-
-    return size;
-}
-
 void Tensor::copyTo(Tensor& other) const
 {
-    other._dims.clear();
-    other._dims.reserve(_dims.size());
-    other._dims.insert(other._dims.end(), _dims.begin(), _dims.end());
+    other._dims = _dims;
 
     other._data.clear();
     other._data.reserve(_data.size());
@@ -313,8 +327,7 @@ void Tensor::resize(std::size_t i)
 {
     PT_ASSERT(i > 0);
 
-    _dims.clear();
-    _dims.push_back(i);
+    _dims = DimsVector{ i };
     _data.resize(i);
 }
 
@@ -323,10 +336,7 @@ void Tensor::resize(std::size_t i, std::size_t j)
     PT_ASSERT(i > 0);
     PT_ASSERT(j > 0);
 
-    _dims.clear();
-    _dims.reserve(2);
-    _dims.push_back(i);
-    _dims.push_back(j);
+    _dims = DimsVector{ i, j };
     _data.resize(i * j);
 }
 
@@ -336,11 +346,7 @@ void Tensor::resize(std::size_t i, std::size_t j, std::size_t k)
     PT_ASSERT(j > 0);
     PT_ASSERT(k > 0);
 
-    _dims.clear();
-    _dims.reserve(3);
-    _dims.push_back(i);
-    _dims.push_back(j);
-    _dims.push_back(k);
+    _dims = DimsVector{ i, j, k };
     _data.resize(i * j * k);
 }
 
@@ -351,12 +357,7 @@ void Tensor::resize(std::size_t i, std::size_t j, std::size_t k, std::size_t l)
     PT_ASSERT(k > 0);
     PT_ASSERT(l > 0);
 
-    _dims.clear();
-    _dims.reserve(4);
-    _dims.push_back(i);
-    _dims.push_back(j);
-    _dims.push_back(k);
-    _dims.push_back(l);
+    _dims = DimsVector{ i, j, k, l };
     _data.resize(i * j * k * l);
 }
 
@@ -369,9 +370,7 @@ void Tensor::flatten()
 {
     PT_ASSERT(isValid());
 
-    auto size = getSize();
-    _dims.clear();
-    _dims.push_back(size);
+    _dims = DimsVector{ getSize() };
 }
 
 void Tensor::unpack(std::size_t row, Tensor& out) const
@@ -380,119 +379,40 @@ void Tensor::unpack(std::size_t row, Tensor& out) const
     PT_ASSERT(_dims.size() >= 2);
     PT_ASSERT(row < _dims[0]);
 
-    auto packSize = std::accumulate(_dims.begin() + 1, _dims.end(), std::size_t(0));
-    auto base = row * packSize;
-    auto first = begin() + long(base);
-    auto last = first + long(packSize);
+    auto packSize = std::accumulate(_dims.begin() + 1, _dims.end(), std::size_t(1), std::multiplies<std::size_t>());
+    auto first = begin() + long(row * packSize);
 
-    out._dims.clear();
-    out._dims.reserve(_dims.size() - 1);
-    out._dims.insert(out._dims.end(), _dims.begin() + 1, _dims.end());
-
-    out._data.clear();
-    out._data.reserve(std::size_t(last - first));
-    out._data.insert(out._data.end(), first, last);
+    // Output buffers are reused:
+    out._dims.assign(_dims.begin() + 1, _dims.end());
+    out._data.assign(first, first + long(packSize));
 }
 
 void Tensor::repeat(int n, int axis, Tensor& out) const
 {
     PT_ASSERT(isValid());
     PT_ASSERT(n > 0);
+    PT_ASSERT(std::size_t(axis) < _dims.size());
 
-    auto numDims = _dims.size();
-    PT_ASSERT(axis < numDims);
-
-    std::vector<std::size_t> repeats(numDims, 1);
-    repeats[std::size_t(axis)] = std::size_t(n);
+    out._dims = _dims;
+    out._dims[std::size_t(axis)] *= std::size_t(n);
 
-    out._dims.clear();
-    out._dims.reserve(_dims.size());
-    out._dims.insert(out._dims.end(), _dims.begin(), _dims.end());
-    out._dims[std::size_t(axis)] = _dims[std::size_t(axis)] * std::size_t(n);
+    // Each block (the values of an index before the axis) is copied n times in a row:
+    std::size_t blockSize = 1;
 
-    out._data.clear();
-    out._data.resize(_data.size() * std::size_t(n));
-
-    if(numDims == 1)
+    for(auto it = _dims.begin() + axis, end = _dims.end(); it != end; ++it)
     {
-        std::size_t dims0 = _dims[0];
-        std::size_t il = dims0 * repeats[0];
-
-        for(std::size_t i = 0; i < il; ++i)
-        {
-            out(i) = (*this)(i % dims0);
-        }
+        blockSize *= *it;
     }
-    else if(numDims == 2)
-    {
-        std::size_t dims0 = _dims[0];
-        std::size_t dims1 = _dims[1];
-        std::size_t il = dims0 * repeats[0];
-        std::size_t jl = dims1 * repeats[1];
 
-        for(std::size_t i = 0; i < il; ++i)
-        {
-            std::size_t im = i % dims0;
-
-            for(std::size_t j = 0; j < jl; ++j)
-            {
-                out(i, j) = (*this)(im, j % dims1);
-            }
-        }
-    }
-    else if(numDims == 3)
-    {
-        std::size_t dims0 = _dims[0];
-        std::size_t dims1 = _dims[1];
-        std::size_t dims2 = _dims[2];
-        std::size_t il = dims0 * repeats[0];
-        std::size_t jl = dims1 * repeats[1];
-        std::size_t kl = dims2 * repeats[2];
-
-        for(std::size_t i = 0; i < il; ++i)
-        {
-            std::size_t im = i % dims0;
+    out._data.resize(_data.size() * std::size_t(n));
 
-            for(std::size_t j = 0; j < jl; ++j)
-            {
-                std::size_t jm = j % dims1;
+    auto outIt = out._data.begin();
 
-                for(std::size_t k = 0; k < kl; ++k)
-                {
-                    out(i, j, k) = (*this)(im, jm, k % dims2);
-                }
-            }
-        }
-    }
-    else
+    for(auto blockIt = _data.begin(), end = _data.end(); blockIt != end; blockIt += long(blockSize))
     {
-        std::size_t dims0 = _dims[0];
-        std::size_t dims1 = _dims[1];
-        std::size_t dims2 = _dims[2];
-        std::size_t dims3 = _dims[3];
-        std::size_t il = dims0 * repeats[0];
-        std::size_t jl = dims1 * repeats[1];
-        std::size_t kl = dims2 * repeats[2];
-        std::size_t ll = dims3 * repeats[3];
-
-        for(std::size_t i = 0; i < il; ++i)
+        for(int index = 0; index != n; ++index)
         {
-            std::size_t im = i % dims0;
-
-            for(std::size_t j = 0; j < jl; ++j)
-            {
-                std::size_t jm = j % dims1;
-
-                for(std::size_t k = 0; k < kl; ++k)
-                {
-                    std::size_t km = k % dims2;
-
-                    for(std::size_t l = 0; l < ll; ++l)
-                    {
-                        out(i, j, k, l) = (*this)(im, jm, km, l % dims3);
-                    }
-                }
-            }
+            outIt = std::copy(blockIt, blockIt + long(blockSize), outIt);
         }
     }
 }
@@ -505,47 +425,22 @@ void Tensor::select(std::size_t row, Tensor& out) const
 
 void Tensor::add(const Tensor& other, Tensor& out, Dispatcher& dispatcher) const
 {
-    PT_ASSERT(_dims == other._dims);
-
-    auto threads = int(dispatcher.threads());
-    auto threadSize = int(getSize()) / threads;
-    copyTo(out);
+    PT_ASSERT(isValid());
+    PT_ASSERT(isBroadcastable(_dims, other._dims));
 
-    if(PT_LOOP_UNROLLING_ENABLE && threadSize && threadSize % (Tensor::VectorSize * 2) == 0)
-    {
-        addImpl<Vector2Add>(other, out, dispatcher);
-    }
-    else if(threadSize && threadSize % Tensor::VectorSize == 0)
-    {
-        addImpl<VectorAdd>(other, out, dispatcher);
-    }
-    else
-    {
-        addImpl<ScalarAdd>(other, out, dispatcher);
-    }
+    out._dims = _dims;
+    out._data.resize(_data.size());
+    binaryImpl<Vector2Add, VectorAdd, ScalarAdd>(*this, other, out, dispatcher);
 }
 
 void Tensor::multiply(const Tensor& other, Tensor& out, Dispatcher& dispatcher) const
 {
     PT_ASSERT(isValid());
-    PT_ASSERT(_dims == other._dims);
+    PT_ASSERT(isBroadcastable(_dims, other._dims));
 
-    auto threads = int(dispatcher.threads());
-    auto threadSize = int(getSize()) / threads;
-    copyTo(out);
-
-    if(PT_LOOP_UNROLLING_ENABLE && threadSize && threadSize % (Tensor::VectorSize * 2) == 0)
-    {
-        multiplyImpl<Vector2Multiply>(other, out, dispatcher);
-    }
-    else if(threadSize && threadSize % Tensor::VectorSize == 0)
-    {
-        multiplyImpl<VectorMultiply>(other, out, dispatcher);
-    }
-    else
-    {
-        multiplyImpl<ScalarMultiply>(other, out, dispatcher);
-    }
+    out._dims = _dims;
+    out._data.resize(_data.size());
+    binaryImpl<Vector2Multiply, VectorMultiply, ScalarMultiply>(*this, other, out, dispatcher);
 }
 
 void Tensor::dot(const Tensor& other, Tensor& out, Dispatcher& dispatcher) const
@@ -556,14 +451,14 @@ void Tensor::dot(const Tensor& other, Tensor& out, Dispatcher& dispatcher) const
 
     out.resize(_dims[0], other._dims[0]);
 
-    auto threads = int(dispatcher.threads());
-    auto threadSize = int(_dims[1]) / threads;
+    // Each task multiplies whole rows, so the vector size must divide the row size:
+    auto rowSize = int(_dims[1]);
 
-    if(PT_LOOP_UNROLLING_ENABLE && threadSize && threadSize % (Tensor::VectorSize * 2) == 0)
+    if(PT_LOOP_UNROLLING_ENABLE && rowSize % (Tensor::VectorSize * 2) == 0)
     {
         dotImpl<Vector2MultiplyAdd>(*this, other, out, dispatcher);
     }
-    else if(threadSize && threadSize % Tensor::VectorSize == 0)
+    else if(rowSize % Tensor::VectorSize == 0)
     {
         dotImpl<VectorMultiplyAdd>(*this, other, out, dispatcher);
     }
@@ -575,24 +470,38 @@ void Tensor::dot(const Tensor& other, Tensor& out, Dispatcher& dispatcher) const
 
 void Tensor::fma(const Tensor& scale, const Tensor& bias, Tensor& out, Dispatcher& dispatcher) const
 {
-    PT_ASSERT(_dims == scale._dims);
-    PT_ASSERT(_dims == bias._dims);
+    PT_ASSERT(isValid());
+    PT_ASSERT(isBroadcastable(_dims, scale._dims));
+    PT_ASSERT(isBroadcastable(_dims, bias._dims));
+    PT_ASSERT(scale.getSize() == bias.getSize());
 
-    auto threads = int(dispatcher.threads());
-    auto threadSize = int(getSize()) / threads;
-    bias.copyTo(out);
+    out._dims = _dims;
+    out._data.resize(_data.size());
 
-    if(PT_LOOP_UNROLLING_ENABLE && threadSize && threadSize % (Tensor::VectorSize * 2) == 0)
-    {
-        multiplyAddImpl<Vector2MultiplyAdd>(scale, *this, out, dispatcher);
-    }
-    else if(threadSize && threadSize % Tensor::VectorSize == 0)
-    {
-        multiplyAddImpl<VectorMultiplyAdd>(scale, *this, out, dispatcher);
-    }
-    else
+    auto size = getSize();
+    auto operandSize = scale.getSize();
+    auto inBegin = _data.data();
+    auto scaleBegin = scale._data.data();
+    auto biasBegin = bias._data.data();
+    auto outBegin = out._data.data();
+
+    switch(vectorStep(size, operandSize))
     {
-        multiplyAddImpl<ScalarMultiplyAdd>(scale, *this, out, dispatcher);
+
+    case Tensor::VectorSize * 2:
+        elementwiseImpl(TernaryOperation<Vector2MultiplyAdd, ScalarMultiplyAdd, Tensor::VectorSize * 2>{
+                            inBegin, scaleBegin, biasBegin, outBegin }, size, operandSize, dispatcher);
+        break;
+
+    case Tensor::VectorSize:
+        elementwiseImpl(TernaryOperation<VectorMultiplyAdd, ScalarMultiplyAdd, Tensor::VectorSize>{
+                            inBegin, scaleBegin, biasBegin, outBegin }, size, operandSize, dispatcher);
+        break;
+
+    default:
+        elementwiseImpl(TernaryOperation<ScalarMultiplyAdd, ScalarMultiplyAdd, 1>{
+                            inBegin, scaleBegin, biasBegin, outBegin }, size, operandSize, dispatcher);
+        break;
     }
 }
 
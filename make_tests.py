@@ -11,10 +11,13 @@ try:
     from keras import backend as K
     from keras.models import Sequential
     from keras.layers import (
-        Conv1D, Conv2D, LocallyConnected1D, Dense, Flatten, Activation,
-        MaxPooling2D, GlobalMaxPooling2D, BatchNormalization, RepeatVector
+        Conv1D, Conv2D, DepthwiseConv2D, SeparableConv2D, LocallyConnected1D,
+        Dense, Flatten, Activation,
+        MaxPooling2D, GlobalMaxPooling2D, AveragePooling2D, GlobalAveragePooling2D,
+        GlobalAveragePooling1D, BatchNormalization, RepeatVector,
+        Masking, Bidirectional
     )
-    from keras.layers.recurrent import LSTM
+    from keras.layers.recurrent import LSTM, GRU
     from keras.layers.advanced_activations import ELU, LeakyReLU
     from keras.layers.embeddings import Embedding
     from keras.engine.input_layer import Input
@@ -23,10 +26,13 @@ except:
     from tensorflow.keras import backend as K
     from tensorflow.keras.models import Sequential
     from tensorflow.keras.layers import (
-        Conv1D, Conv2D, LocallyConnected1D, Dense, Flatten, Activation,
-        MaxPooling2D, GlobalMaxPooling2D, BatchNormalization, RepeatVector
+        Conv1D, Conv2D, DepthwiseConv2D, SeparableConv2D, LocallyConnected1D,
+        Dense, Flatten, Activation,
+        MaxPooling2D, GlobalMaxPooling2D, AveragePooling2D, GlobalAveragePooling2D,
+        GlobalAveragePooling1D, BatchNormalization, RepeatVector,
+        Masking, Bidirectional
     )
-    from tensorflow.keras.layers import LSTM
+    from tensorflow.keras.layers import LSTM, GRU
     from tensorflow.keras.layers import ELU, LeakyReLU
     from tensorflow.keras.layers import Embedding
     from tensorflow.keras.engine.input_layer import Input
@@ -199,6 +205,29 @@ model = Sequential([
 output_testcase(model, test_x, test_y, 'conv1d_3x3', '1e-6')
 
 
+''' Conv1D 3 causal dilated '''
+test_x = np.random.rand(10, 20, 2).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Conv1D(8, 3, padding='causal', dilation_rate=2, activation='relu', input_shape=(20, 2)),
+    Conv1D(8, 3, padding='causal', dilation_rate=4),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'conv1d_3_causal_dilated', '1e-6')
+
+
+''' Conv1D 5 strided same '''
+test_x = np.random.rand(10, 21, 3).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Conv1D(5, 5, strides=2, padding='same', input_shape=(21, 3)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'conv1d_5_strided_same', '1e-6')
+
+
 ''' Conv 2x2 '''
 test_x = np.random.rand(10, 2, 2, 1).astype('f')
 test_y = np.random.rand(10, 1).astype('f')
@@ -233,6 +262,79 @@ model = Sequential([
 output_testcase(model, test_x, test_y, 'conv_3x3x3', '1e-6')
 
 
+''' Conv 3x3x3 + per channel BatchNormalization '''
+test_x = np.random.rand(10, 10, 10, 3).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Conv2D(8, (3, 3), input_shape=(10, 10, 3)),
+    BatchNormalization(),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'conv_3x3x3_batch_normalization', '1e-6')
+
+
+''' Conv 3x3 strided same '''
+test_x = np.random.rand(10, 11, 9, 8).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Conv2D(4, (3, 3), strides=(2, 2), padding='same', input_shape=(11, 9, 8)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'conv_3x3_strided_same', '1e-6')
+
+
+''' Conv 3x3 dilated '''
+test_x = np.random.rand(10, 12, 12, 3).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Conv2D(4, (3, 3), dilation_rate=(2, 2), padding='same', input_shape=(12, 12, 3)),
+    Conv2D(2, (3, 3), dilation_rate=(2, 1)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'conv_3x3_dilated', '1e-6')
+
+
+''' Conv 3x3 deep '''
+test_x = np.random.rand(10, 9, 9, 64).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Conv2D(64, (3, 3), padding='same', input_shape=(9, 9, 64)),
+    Conv2D(64, (3, 3), strides=(2, 2)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'conv_3x3_deep', '1e-5')
+
+
+''' Depthwise conv 3x3 '''
+test_x = np.random.rand(10, 9, 9, 16).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    DepthwiseConv2D((3, 3), padding='same', input_shape=(9, 9, 16)),
+    DepthwiseConv2D((3, 3), strides=(2, 2), depth_multiplier=2,
+                    activation='relu'),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'depthwise_conv_3x3', '1e-6')
+
+
+''' Separable conv 3x3 '''
+test_x = np.random.rand(10, 12, 12, 8).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    SeparableConv2D(32, (3, 3), padding='same', activation='relu',
+                    input_shape=(12, 12, 8)),
+    SeparableConv2D(64, (3, 3), strides=(2, 2), depth_multiplier=2),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'separable_conv_3x3', '1e-5')
+
+
 ''' LocallyConnected1D 2 '''
 test_x = np.random.rand(10, 2, 1).astype('f')
 test_y = np.random.rand(10, 1).astype('f')
@@ -464,6 +566,75 @@ model = Sequential([
 output_testcase(model, test_x, test_y, 'maxpool2d_8x3x3', '1e-6')
 
 
+''' Maxpooling2D 5x3x3 strided same'''
+test_x = np.random.rand(10, 11, 10, 5).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    MaxPooling2D(pool_size=(3, 3), strides=(2, 2), padding='same', input_shape=(11, 10, 5)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'maxpool2d_5x3x3_strided_same', '1e-6')
+
+
+''' Maxpooling2D 16x3x2 strided'''
+test_x = np.random.rand(10, 10, 11, 16).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    MaxPooling2D(pool_size=(3, 2), strides=(2, 1), input_shape=(10, 11, 16)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'maxpool2d_16x3x2_strided', '1e-6')
+
+
+''' AveragePooling2D 3x2x2'''
+test_x = np.random.rand(10, 10, 10, 3).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    AveragePooling2D(pool_size=(2, 2), input_shape=(10, 10, 3)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'avgpool2d_3x2x2', '1e-6')
+
+
+''' AveragePooling2D 12x3x3 strided same'''
+test_x = np.random.rand(10, 11, 10, 12).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    AveragePooling2D(pool_size=(3, 3), strides=(2, 2), padding='same', input_shape=(11, 10, 12)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'avgpool2d_12x3x3_strided_same', '1e-6')
+
+
+''' Conv2D + Maxpooling2D 8x2x2 (fused)'''
+test_x = np.random.rand(10, 10, 10, 3).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Conv2D(8, (3, 3), padding='same', activation='relu', input_shape=(10, 10, 3)),
+    MaxPooling2D(pool_size=(2, 2)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'conv_maxpool2d_8x2x2', '1e-6')
+
+
+''' Conv2D + Activation + Maxpooling2D 16x3x3 (fused)'''
+test_x = np.random.rand(10, 10, 10, 8).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Conv2D(16, (3, 3), input_shape=(10, 10, 8)),
+    Activation('tanh'),
+    MaxPooling2D(pool_size=(3, 3)),
+    Flatten(),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'conv_tanh_maxpool2d_16x3x3', '1e-6')
+
+
 ''' GlobalMaxpooling2D 1'''
 test_x = np.random.rand(10, 10, 10, 1).astype('f')
 test_y = np.random.rand(10, 1).astype('f')
@@ -491,6 +662,33 @@ model = Sequential([
 output_testcase(model, test_x, test_y, 'global_maxpool2d_8', '1e-6')
 
 
+''' GlobalAveragePooling2D 3'''
+test_x = np.random.rand(10, 10, 10, 3).astype('f')
+test_y = np.random.rand(10, 3).astype('f')
+model = Sequential([
+    GlobalAveragePooling2D(input_shape=(10, 10, 3))
+])
+output_testcase(model, test_x, test_y, 'global_avgpool2d_3', '1e-6')
+
+
+''' GlobalAveragePooling2D 20'''
+test_x = np.random.rand(10, 10, 10, 20).astype('f')
+test_y = np.random.rand(10, 20).astype('f')
+model = Sequential([
+    GlobalAveragePooling2D(input_shape=(10, 10, 20))
+])
+output_testcase(model, test_x, test_y, 'global_avgpool2d_20', '1e-6')
+
+
+''' GlobalAveragePooling1D 16'''
+test_x = np.random.rand(10, 12, 16).astype('f')
+test_y = np.random.rand(10, 16).astype('f')
+model = Sequential([
+    GlobalAveragePooling1D(input_shape=(12, 16))
+])
+output_testcase(model, test_x, test_y, 'global_avgpool1d_16', '1e-6')
+
+
 ''' LSTM simple 7x20 '''
 test_x = np.random.rand(10, 7, 20).astype('f')
 test_y = np.random.rand(10, 3).astype('f')
@@ -522,6 +720,37 @@ model = Sequential([
 output_testcase(model, test_x, test_y, 'lstm_stacked_64x83', '1e-6')
 
 
+''' Bidirectional LSTM 16x9 '''
+test_x = np.random.rand(10, 16, 9).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Bidirectional(LSTM(8, return_sequences=True), input_shape=(16, 9)),
+    Bidirectional(LSTM(4, return_sequences=False), merge_mode='sum'),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'bidirectional_lstm_16x9', '1e-6')
+
+
+''' GRU simple 7x20 '''
+test_x = np.random.rand(10, 7, 20).astype('f')
+test_y = np.random.rand(10, 3).astype('f')
+model = Sequential([
+    GRU(3, return_sequences=False, reset_after=False, input_shape=(7, 20))
+])
+output_testcase(model, test_x, test_y, 'gru_simple_7x20', '1e-6')
+
+
+''' GRU stacked 64x83 '''
+test_x = np.random.rand(10, 64, 83).astype('f')
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    GRU(16, return_sequences=True, reset_after=False, input_shape=(64, 83)),
+    GRU(16, return_sequences=False, reset_after=True),
+    Dense(1, activation='sigmoid')
+])
+output_testcase(model, test_x, test_y, 'gru_stacked_64x83', '1e-6')
+
+
 ''' Embedding 64 '''
 np.random.seed(10)
 test_x = np.random.randint(100, size=(32, 10)).astype('f')
@@ -552,3 +781,53 @@ model = Sequential([
 ])
 output_testcase(model, test_x, test_y, 'repeat_vector', '1e-6')
 
+
+''' RepeatVector + LSTM (fused) '''
+test_x = np.random.rand(10, 16).astype('f')
+test_y = np.random.rand(10, 5, 8).astype('f')
+model = Sequential([
+    Dense(12, input_dim=16),
+    RepeatVector(5),
+    LSTM(8, return_sequences=True)
+])
+output_testcase(model, test_x, test_y, 'repeat_vector_lstm', '1e-6')
+
+
+
+''' Embedding mask zero '''
+np.random.seed(11)
+test_x = np.random.randint(1, 50, size=(32, 12)).astype('f')
+test_x[:, :4] = 0
+test_x[:, 7] = 0
+test_y = np.random.rand(32, 1).astype('f')
+model = Sequential([
+    Embedding(50, 16, input_length=12, mask_zero=True),
+    LSTM(8, return_sequences=True),
+    LSTM(4, return_sequences=False),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'embedding_mask_zero', '1e-6')
+
+
+''' Embedding + LSTM 16 (fused) '''
+test_x = np.random.randint(200, size=(32, 20)).astype('f')
+test_y = np.random.rand(32, 1).astype('f')
+model = Sequential([
+    Embedding(200, 32, input_length=20),
+    LSTM(16, return_sequences=False),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'embedding_lstm_16', '1e-6')
+
+
+''' Masking '''
+test_x = np.random.rand(10, 16, 9).astype('f')
+test_x[:, :5, :] = 0
+test_x[:, 11, :] = 0
+test_y = np.random.rand(10, 1).astype('f')
+model = Sequential([
+    Masking(mask_value=0, input_shape=(16, 9)),
+    LSTM(8, return_sequences=False),
+    Dense(1)
+])
+output_testcase(model, test_x, test_y, 'masking_lstm', '1e-6')
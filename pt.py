@@ -16,6 +16,23 @@ LAYER_LEAKY_RELU = 13
 LAYER_GLOBAL_MAXPOOLING_2D = 14
 LAYER_INPUT = 15
 LAYER_REPEAT_VECTOR = 16
+LAYER_MASKING = 17
+LAYER_GRU = 18
+LAYER_BIDIRECTIONAL = 19
+LAYER_DEPTHWISE_CONV_2D = 20
+LAYER_SEPARABLE_CONV_2D = 21
+LAYER_AVERAGEPOOLING_2D = 22
+LAYER_GLOBAL_AVERAGEPOOLING_2D = 23
+LAYER_GLOBAL_AVERAGEPOOLING_1D = 24
+
+# Model files start with a magic number and a format version.
+# Models exported with another format version must be exported again:
+MODEL_MAGIC = 0x4d4f5450
+MODEL_FORMAT_VERSION = 2
+
+EMBEDDING_FLOAT32 = 0
+EMBEDDING_FLOAT16 = 1
+EMBEDDING_INT8 = 2
 
 ACTIVATION_LINEAR = 1
 ACTIVATION_RELU = 2
@@ -112,13 +129,23 @@ def export_layer_conv1d(f, layer):
     biases = layer.get_weights()[1]
     activation = layer.get_config()['activation']
 
+    strides = layer.get_config()['strides']
+    padding = layer.get_config()['padding']
+    dilation_rate = layer.get_config()['dilation_rate']
+    paddings = ['valid', 'same', 'causal']
+    assert padding in paddings, "Unsupported padding type: %s" % padding
+
     weights = weights.transpose(2, 0, 1)
     # shape: (outputs, steps, dims)
 
     f.write(struct.pack('I', LAYER_CONV_1D))
     write_tensor(f, weights, 3)
     write_tensor(f, biases)
+
     export_activation(f, activation)
+    f.write(struct.pack('I', strides[0]))
+    f.write(struct.pack('I', paddings.index(padding)))
+    f.write(struct.pack('I', dilation_rate[0]))
 
 
 def export_layer_conv2d(f, layer):
@@ -126,6 +153,11 @@ def export_layer_conv2d(f, layer):
     biases = layer.get_weights()[1]
     activation = layer.get_config()['activation']
 
+    strides = layer.get_config()['strides']
+    padding = layer.get_config()['padding']
+    dilation_rate = layer.get_config()['dilation_rate']
+    assert padding in ['valid', 'same'], "Unsupported padding type: %s" % padding
+
     weights = weights.transpose(3, 0, 1, 2)
     # shape: (outputs, rows, cols, depth)
 
@@ -134,6 +166,65 @@ def export_layer_conv2d(f, layer):
     write_tensor(f, biases)
 
     export_activation(f, activation)
+    f.write(struct.pack('I', strides[0]))
+    f.write(struct.pack('I', strides[1]))
+    f.write(struct.pack('I', padding == 'same'))
+    f.write(struct.pack('I', dilation_rate[0]))
+    f.write(struct.pack('I', dilation_rate[1]))
+
+
+def export_depthwise_conv2d(f, layer, weights):
+    depth_multiplier = layer.get_config()['depth_multiplier']
+    strides = layer.get_config()['strides']
+    padding = layer.get_config()['padding']
+    dilation_rate = layer.get_config()['dilation_rate']
+    assert padding in ['valid', 'same'], "Unsupported padding type: %s" % padding
+
+    weights = weights.reshape(weights.shape[0], weights.shape[1], -1)
+    # shape: (rows, cols, depth * depth_multiplier)
+
+    write_tensor(f, weights, 3)
+    f.write(struct.pack('I', depth_multiplier))
+    f.write(struct.pack('I', strides[0]))
+    f.write(struct.pack('I', strides[1]))
+    f.write(struct.pack('I', padding == 'same'))
+    f.write(struct.pack('I', dilation_rate[0]))
+    f.write(struct.pack('I', dilation_rate[1]))
+
+
+def export_layer_depthwise_conv2d(f, layer):
+    weights = layer.get_weights()[0]
+    activation = layer.get_config()['activation']
+
+    if layer.get_config()['use_bias']:
+        biases = layer.get_weights()[1]
+    else:
+        biases = np.zeros(weights.shape[2] * weights.shape[3], dtype='f')
+
+    f.write(struct.pack('I', LAYER_DEPTHWISE_CONV_2D))
+    export_depthwise_conv2d(f, layer, weights)
+    write_tensor(f, biases)
+    export_activation(f, activation)
+
+
+def export_layer_separable_conv2d(f, layer):
+    depthwise_weights = layer.get_weights()[0]
+    pointwise_weights = layer.get_weights()[1]
+    activation = layer.get_config()['activation']
+
+    pointwise_weights = pointwise_weights.reshape(pointwise_weights.shape[2:])
+    # shape: (depth * depth_multiplier, outputs)
+
+    if layer.get_config()['use_bias']:
+        biases = layer.get_weights()[2]
+    else:
+        biases = np.zeros(pointwise_weights.shape[1], dtype='f')
+
+    f.write(struct.pack('I', LAYER_SEPARABLE_CONV_2D))
+    export_depthwise_conv2d(f, layer, depthwise_weights)
+    write_tensor(f, pointwise_weights, 2)
+    write_tensor(f, biases)
+    export_activation(f, activation)
 
 
 def export_layer_locally1d(f, layer):
@@ -152,15 +243,26 @@ def export_layer_locally1d(f, layer):
     export_activation(f, activation)
 
 
-def export_layer_maxpooling2d(f, layer):
+def export_layer_pooling2d(f, layer, layer_id):
     pool_size = layer.get_config()['pool_size']
+    strides = layer.get_config()['strides']
+    padding = layer.get_config()['padding']
+    assert padding in ['valid', 'same'], "Unsupported padding type: %s" % padding
 
-    f.write(struct.pack('I', LAYER_MAXPOOLING_2D))
+    f.write(struct.pack('I', layer_id))
     f.write(struct.pack('I', pool_size[0]))
     f.write(struct.pack('I', pool_size[1]))
+    f.write(struct.pack('I', strides[0]))
+    f.write(struct.pack('I', strides[1]))
+    f.write(struct.pack('I', padding == 'same'))
 
 
 def export_layer_lstm(f, layer):
+    f.write(struct.pack('I', LAYER_LSTM))
+    export_lstm(f, layer)
+
+
+def export_lstm(f, layer):
     inner_activation = layer.get_config()['recurrent_activation']
     activation = layer.get_config()['activation']
     return_sequences = int(layer.get_config()['return_sequences'])
@@ -183,8 +285,6 @@ def export_layer_lstm(f, layer):
     b_c = weights[2][units*2: -units].reshape((1, -1))
     b_o = weights[2][-units:].reshape((1, -1))
 
-    f.write(struct.pack('I', LAYER_LSTM))
-
     write_tensor(f, W_i, 2)
     write_tensor(f, U_i, 2)
     write_tensor(f, b_i, 2)
@@ -206,18 +306,97 @@ def export_layer_lstm(f, layer):
     f.write(struct.pack('I', return_sequences))
 
 
-def export_layer_embedding(f, layer):
+def export_layer_bidirectional(f, layer):
+    merge_modes = {'concat': 1, 'sum': 2, 'mul': 3, 'ave': 4}
+    merge_mode = layer.get_config()['merge_mode']
+    assert merge_mode in merge_modes, "Unsupported merge mode: %s" % merge_mode
+
+    forward_type = type(layer.forward_layer).__name__
+    assert forward_type == 'LSTM', "Unsupported bidirectional layer type: %s" % forward_type
+
+    f.write(struct.pack('I', LAYER_BIDIRECTIONAL))
+    f.write(struct.pack('I', merge_modes[merge_mode]))
+    export_lstm(f, layer.forward_layer)
+    export_lstm(f, layer.backward_layer)
+
+
+def export_layer_gru(f, layer):
+    inner_activation = layer.get_config()['recurrent_activation']
+    activation = layer.get_config()['activation']
+    return_sequences = int(layer.get_config()['return_sequences'])
+    reset_after = int(layer.get_config().get('reset_after', False))
+
+    weights = layer.get_weights()
+    units = layer.units
+
+    W = weights[0].transpose()
+    U = weights[1].transpose()
+
+    if layer.use_bias:
+        b = weights[2].reshape((-1, units * 3))
+    else:
+        b = np.zeros((1, units * 3), dtype='f')
+
+    if b.shape[0] == 1:
+        b = np.vstack([b, np.zeros((1, units * 3), dtype='f')])
+
+    f.write(struct.pack('I', LAYER_GRU))
+
+    write_tensor(f, W, 2)
+    write_tensor(f, U, 2)
+    write_tensor(f, b, 2)
+
+    export_activation(f, inner_activation)
+    export_activation(f, activation)
+    f.write(struct.pack('I', return_sequences))
+    f.write(struct.pack('I', reset_after))
+
+
+def export_layer_embedding(f, layer, storage):
     weights = layer.get_weights()[0]
 
     f.write(struct.pack('I', LAYER_EMBEDDING))
-    write_tensor(f, weights, 2)
 
+    if storage == 'float32':
+        f.write(struct.pack('I', EMBEDDING_FLOAT32))
+        write_tensor(f, weights, 2)
 
-def export_model(model, filename):
+    elif storage == 'float16':
+        f.write(struct.pack('I', EMBEDDING_FLOAT16))
+        f.write(struct.pack('II', *weights.shape))
+        f.write(weights.astype('<f2').tobytes())
+
+    elif storage == 'int8':
+        # Per row affine quantization, decoded as offset + code * scale:
+        mins = weights.min(axis=1)
+        scales = (weights.max(axis=1) - mins) / 255
+        scales[scales == 0] = 1
+        codes = np.clip(np.round((weights - mins[:, None]) / scales[:, None]), 0, 255)
+
+        f.write(struct.pack('I', EMBEDDING_INT8))
+        f.write(struct.pack('II', *weights.shape))
+        f.write(scales.astype('<f4').tobytes())
+        f.write(mins.astype('<f4').tobytes())
+        f.write(codes.astype(np.uint8).tobytes())
+
+    else:
+        assert False, "Unsupported embedding storage: %s" % storage
+
+    mask_zero = layer.get_config()['mask_zero']
+    f.write(struct.pack('I', mask_zero))
+
+
+def export_model(model, filename, embedding_storage='float32'):
+    '''
+    Embedding weights are stored as float32, float16 or int8
+    depending on embedding_storage.
+    '''
     with open(filename, 'wb') as f:
         model_layers = [
             l for l in model.layers if type(l).__name__ not in ['Dropout']]
         num_layers = len(model_layers)
+        f.write(struct.pack('I', MODEL_MAGIC))
+        f.write(struct.pack('I', MODEL_FORMAT_VERSION))
         f.write(struct.pack('I', num_layers))
 
         for layer in model_layers:
@@ -232,6 +411,12 @@ def export_model(model, filename):
             elif layer_type == 'Conv2D':
                 export_layer_conv2d(f, layer)
 
+            elif layer_type == 'DepthwiseConv2D':
+                export_layer_depthwise_conv2d(f, layer)
+
+            elif layer_type == 'SeparableConv2D':
+                export_layer_separable_conv2d(f, layer)
+
             elif layer_type == 'LocallyConnected1D':
                 export_layer_locally1d(f, layer)
 
@@ -248,16 +433,31 @@ def export_model(model, filename):
                 export_activation(f, activation)
 
             elif layer_type == 'MaxPooling2D':
-                export_layer_maxpooling2d(f, layer)
+                export_layer_pooling2d(f, layer, LAYER_MAXPOOLING_2D)
+
+            elif layer_type == 'AveragePooling2D':
+                export_layer_pooling2d(f, layer, LAYER_AVERAGEPOOLING_2D)
 
             elif layer_type == 'GlobalMaxPooling2D':
                 f.write(struct.pack('I', LAYER_GLOBAL_MAXPOOLING_2D))
 
+            elif layer_type == 'GlobalAveragePooling2D':
+                f.write(struct.pack('I', LAYER_GLOBAL_AVERAGEPOOLING_2D))
+
+            elif layer_type == 'GlobalAveragePooling1D':
+                f.write(struct.pack('I', LAYER_GLOBAL_AVERAGEPOOLING_1D))
+
             elif layer_type == 'LSTM':
                 export_layer_lstm(f, layer)
 
+            elif layer_type == 'Bidirectional':
+                export_layer_bidirectional(f, layer)
+
+            elif layer_type == 'GRU':
+                export_layer_gru(f, layer)
+
             elif layer_type == 'Embedding':
-                export_layer_embedding(f, layer)
+                export_layer_embedding(f, layer, embedding_storage)
 
             elif layer_type == 'BatchNormalization':
                 export_layer_normalization(f, layer)
@@ -274,5 +474,10 @@ def export_model(model, filename):
                 n = layer.get_config()['n']
                 f.write(struct.pack('I', n))
 
+            elif layer_type == 'Masking':
+                f.write(struct.pack('I', LAYER_MASKING))
+                mask_value = layer.get_config()['mask_value']
+                f.write(struct.pack('f', mask_value))
+
             else:
                 assert False, "Unsupported layer type: %s" % layer_type
@@ -1,9 +1,30 @@
 #ifndef TEST_UTIL_H
 #define TEST_UTIL_H
 
+#include <random>
+#include <ostream>
 #include "catch.hpp"
 #include "pt_tensor.h"
 
 void testModel(pt::Tensor& in, const pt::Tensor& expected, const char* modelFileName, float eps);
 
+// Requires the same dims and values which differ at most eps:
+void testTensors(const pt::Tensor& out, const pt::Tensor& expected, float eps);
+
+// Model file stream writers:
+void writeValue(std::ostream& stream, unsigned int value);
+
+void writeValue(std::ostream& stream, float value);
+
+// Magic number, format version and layers count:
+void writeModelHeader(std::ostream& stream, unsigned int layersCount);
+
+// Conv2D layer with random weights:
+void writeConv2D(std::ostream& stream, unsigned int filters, unsigned int kernelSize, unsigned int channels,
+                 unsigned int stride, bool samePadding, unsigned int activation, std::mt19937& random);
+
+// LSTM layer with random weights, sigmoid inner activation and tanh activation:
+void writeLstm(std::ostream& stream, unsigned int units, unsigned int features, bool returnSequences,
+               std::mt19937& random);
+
 #endif
@@ -0,0 +1,144 @@
+#include "test_util.h"
+
+#include <random>
+#include <vector>
+#include <sstream>
+#include "pt_model.h"
+#include "pt_rnn_state.h"
+
+namespace
+{
+    const std::size_t steps = 21;
+    const unsigned int validPadding = 0;
+    const unsigned int samePadding = 1;
+    const unsigned int causalPadding = 2;
+
+    // Single Conv1D layer model with random weights and linear activation:
+    std::unique_ptr<pt::Model> conv1DModel(unsigned int filters, unsigned int kernelSize, unsigned int channels,
+                                           unsigned int dilation, unsigned int stride, unsigned int padding)
+    {
+        std::mt19937 random(filters * 100 + kernelSize * 10 + channels + dilation);
+        std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+        std::ostringstream stream;
+
+        writeModelHeader(stream, 1);
+        writeValue(stream, 2u); // Conv1D layer
+
+        writeValue(stream, filters);
+        writeValue(stream, kernelSize);
+        writeValue(stream, channels);
+
+        for(unsigned int i = 0; i != filters * kernelSize * channels; ++i)
+        {
+            writeValue(stream, distribution(random));
+        }
+
+        writeValue(stream, filters);
+
+        for(unsigned int i = 0; i != filters; ++i)
+        {
+            writeValue(stream, distribution(random));
+        }
+
+        writeValue(stream, 1u); // Linear activation
+        writeValue(stream, stride);
+        writeValue(stream, padding);
+        writeValue(stream, dilation);
+
+        std::istringstream inStream(stream.str());
+        return pt::Model::create(inStream);
+    }
+
+    void testSteps(unsigned int filters, unsigned int kernelSize, unsigned int channels, unsigned int dilation,
+                   const std::vector<std::size_t>& chunksSteps, unsigned int padding = causalPadding,
+                   bool flatSingleSteps = false)
+    {
+        auto model = conv1DModel(filters, kernelSize, channels, dilation, 1, padding);
+        REQUIRE(model);
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> distribution(-1, 1);
+        pt::Tensor in(steps, channels);
+
+        for(auto& value : in)
+        {
+            value = pt::Tensor::Type(distribution(random));
+        }
+
+        pt::Tensor expected;
+        REQUIRE(model->predict(in, expected));
+
+        pt::RnnState state;
+        std::vector<pt::Tensor::Type> outputs;
+        std::size_t firstStep = 0;
+
+        for(auto chunkSteps : chunksSteps)
+        {
+            auto chunkBegin = in.begin() + long(firstStep * channels);
+            pt::Tensor stepIn(chunkSteps, channels);
+            std::copy(chunkBegin, chunkBegin + long(chunkSteps * channels), stepIn.begin());
+
+            if(flatSingleSteps && chunkSteps == 1)
+            {
+                stepIn.flatten();
+            }
+
+            pt::Tensor out;
+            REQUIRE(model->step(state, std::move(stepIn), out));
+            outputs.insert(outputs.end(), out.begin(), out.end());
+            firstStep += chunkSteps;
+        }
+
+        REQUIRE(firstStep == steps);
+
+        pt::Tensor out(steps, filters);
+        REQUIRE(outputs.size() == out.getSize());
+        std::copy(outputs.begin(), outputs.end(), out.begin());
+        testTensors(out, expected, 1e-5f);
+    }
+}
+
+TEST_CASE("Conv1D causal single steps test")
+{
+    testSteps(8, 3, 4, 1, std::vector<std::size_t>(steps, 1));
+    testSteps(5, 5, 3, 2, std::vector<std::size_t>(steps, 1));
+}
+
+TEST_CASE("Conv1D causal 1D steps test")
+{
+    // Model::step single steps can be given as (channels) tensors:
+    testSteps(8, 3, 4, 1, std::vector<std::size_t>(steps, 1), causalPadding, true);
+    testSteps(5, 5, 3, 2, { 1, 1, 4, 1, 7, 1, 1, 5 }, causalPadding, true);
+}
+
+TEST_CASE("Conv1D causal chunks test")
+{
+    // Chunks smaller and larger than the kernel history, growing and shrinking:
+    testSteps(8, 3, 4, 1, { 7, 7, 7 });
+    testSteps(16, 2, 8, 3, { 1, 2, 9, 1, 4, 4 });
+    testSteps(5, 5, 3, 2, { 3, 12, 1, 5 });
+}
+
+TEST_CASE("Conv1D kernel size 1 steps test")
+{
+    testSteps(8, 1, 4, 1, { 3, 1, 9, 8 }, validPadding);
+    testSteps(8, 1, 4, 1, std::vector<std::size_t>(steps, 1), samePadding);
+}
+
+TEST_CASE("Conv1D non streamable steps test")
+{
+    // Non causal or strided layers would convolve each chunk in isolation:
+    auto validModel = conv1DModel(8, 3, 4, 1, 1, validPadding);
+    auto sameModel = conv1DModel(8, 3, 4, 1, 1, samePadding);
+    auto stridedModel = conv1DModel(8, 3, 4, 1, 2, causalPadding);
+    auto stridedKernel1Model = conv1DModel(8, 1, 4, 1, 2, validPadding);
+
+    for(auto model : { validModel.get(), sameModel.get(), stridedModel.get(), stridedKernel1Model.get() })
+    {
+        REQUIRE(model);
+
+        pt::RnnState state;
+        pt::Tensor out;
+        REQUIRE(! model->step(state, pt::Tensor(4, 4), out));
+    }
+}
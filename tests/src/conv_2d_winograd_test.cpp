@@ -0,0 +1,63 @@
+#include "test_util.h"
+
+#include <random>
+#include <sstream>
+#include "pt_model.h"
+#include "pt_dispatcher.h"
+
+namespace
+{
+    // Single Conv2D 3x3 layer model with random weights and linear activation:
+    std::string conv2DModel(unsigned int filters, unsigned int channels, bool samePadding, std::mt19937& random)
+    {
+        std::ostringstream stream;
+
+        writeModelHeader(stream, 1);
+        writeConv2D(stream, filters, 3, channels, 1, samePadding, 1, random);
+        return stream.str();
+    }
+
+    void testWinograd(unsigned int filters, unsigned int channels, std::size_t rows, std::size_t cols,
+                      bool samePadding)
+    {
+        std::mt19937 random(filters * channels + rows);
+        std::istringstream stream(conv2DModel(filters, channels, samePadding, random));
+        auto model = pt::Model::create(stream);
+        REQUIRE(model);
+
+        pt::Tensor in(rows, cols, channels);
+        std::uniform_real_distribution<float> distribution(0, 1);
+
+        for(auto& value : in)
+        {
+            value = pt::Tensor::Type(distribution(random));
+        }
+
+        pt::Dispatcher dispatcher;
+        pt::Tensor winogradIn = in;
+        pt::Tensor winogradOut;
+        model->getConfig().setConv2DWinograd(true);
+        REQUIRE(model->predict(dispatcher, winogradIn, winogradOut));
+
+        pt::Tensor directOut;
+        model->getConfig().setConv2DWinograd(false);
+        REQUIRE(model->predict(dispatcher, in, directOut));
+
+        testTensors(winogradOut, directOut, 1e-4f);
+    }
+}
+
+TEST_CASE("conv_2d_winograd_valid")
+{
+    testWinograd(16, 3, 11, 14, false);
+}
+
+TEST_CASE("conv_2d_winograd_same")
+{
+    testWinograd(32, 8, 9, 12, true);
+}
+
+TEST_CASE("conv_2d_winograd_deep")
+{
+    testWinograd(64, 64, 13, 7, true);
+}
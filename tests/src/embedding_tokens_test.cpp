@@ -0,0 +1,156 @@
+#include "test_util.h"
+
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include "pt_model.h"
+#include "pt_dispatcher.h"
+
+namespace
+{
+    void writeHalf(std::ostream& stream, float value)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        // Only zero and normal values are written:
+        std::uint16_t half = std::uint16_t((bits >> 16) & 0x8000);
+
+        if(bits & 0x7fffffff)
+        {
+            half = std::uint16_t(half | ((((bits >> 23) & 0xff) - 112) << 10) | ((bits >> 13) & 0x3ff));
+        }
+
+        stream.write(reinterpret_cast<const char*>(&half), sizeof(half));
+    }
+
+    // Input and Embedding layers model with random weights.
+    // Weights are exactly representable in every storage type, so all of them give the same output:
+    std::string embeddingModel(unsigned int rows, unsigned int cols, bool maskZero, unsigned int storage,
+                               std::mt19937& random)
+    {
+        std::uniform_int_distribution<unsigned int> distribution(0, 255);
+        std::vector<unsigned int> codes(rows * cols);
+        float scale = 1.0f / 128;
+        float offset = -1;
+
+        for(auto& code : codes)
+        {
+            code = distribution(random);
+        }
+
+        std::ostringstream stream;
+
+        writeModelHeader(stream, 2);
+        writeValue(stream, 15u); // Input layer
+
+        writeValue(stream, 11u); // Embedding layer
+        writeValue(stream, storage);
+        writeValue(stream, rows);
+        writeValue(stream, cols);
+
+        if(storage == 2)
+        {
+            for(unsigned int i = 0; i != rows; ++i)
+            {
+                writeValue(stream, scale);
+            }
+
+            for(unsigned int i = 0; i != rows; ++i)
+            {
+                writeValue(stream, offset);
+            }
+
+            for(auto code : codes)
+            {
+                stream.put(char(code));
+            }
+        }
+        else
+        {
+            for(auto code : codes)
+            {
+                float value = offset + float(code) * scale;
+
+                if(storage == 1)
+                {
+                    writeHalf(stream, value);
+                }
+                else
+                {
+                    writeValue(stream, value);
+                }
+            }
+        }
+
+        writeValue(stream, maskZero ? 1u : 0u);
+        return stream.str();
+    }
+
+    void testEmbeddingTokens(std::size_t threads, std::size_t steps)
+    {
+        std::mt19937 random(unsigned(threads * steps));
+        std::istringstream stream(embeddingModel(1000, 20, true, 0, random));
+        auto model = pt::Model::create(stream);
+        REQUIRE(model);
+
+        pt::TokenVector tokens(steps);
+        pt::Tensor in(steps);
+        std::uniform_int_distribution<unsigned int> distribution(0, 999);
+
+        for(std::size_t i = 0; i != steps; ++i)
+        {
+            tokens[i] = distribution(random);
+            in(i) = pt::Tensor::Type(tokens[i]);
+        }
+
+        pt::Dispatcher dispatcher(threads);
+        pt::Tensor tokensOut;
+        REQUIRE(model->predict(dispatcher, tokens, tokensOut));
+
+        pt::Tensor out;
+        REQUIRE(model->predict(dispatcher, in, out));
+
+        testTensors(tokensOut, out, 0);
+    }
+}
+
+TEST_CASE("embedding_tokens_short")
+{
+    testEmbeddingTokens(1, 7);
+}
+
+TEST_CASE("embedding_tokens_long")
+{
+    testEmbeddingTokens(4, 1000);
+}
+
+TEST_CASE("embedding_tokens_invalid")
+{
+    std::mt19937 random(1);
+    std::istringstream stream(embeddingModel(10, 4, false, 0, random));
+    auto model = pt::Model::create(stream);
+    REQUIRE(model);
+
+    pt::Tensor out;
+    REQUIRE(! model->predict(pt::TokenVector{ 1, 2, 10 }, out));
+}
+
+TEST_CASE("embedding_tokens_quantized")
+{
+    pt::TokenVector tokens{ 3, 0, 999, 512, 3, 77 };
+    pt::Tensor outs[3];
+
+    for(unsigned int storage = 0; storage != 3; ++storage)
+    {
+        std::mt19937 random(2);
+        std::istringstream stream(embeddingModel(1000, 20, false, storage, random));
+        auto model = pt::Model::create(stream);
+        REQUIRE(model);
+        REQUIRE(model->predict(tokens, outs[storage]));
+    }
+
+    testTensors(outs[1], outs[0], 0);
+    testTensors(outs[2], outs[0], 0);
+}
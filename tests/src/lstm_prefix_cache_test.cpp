@@ -0,0 +1,174 @@
+#include "test_util.h"
+
+#include <random>
+#include <sstream>
+#include "pt_model.h"
+#include "pt_config.h"
+#include "pt_dispatcher.h"
+#include "pt_lstm_prefix_cache.h"
+
+namespace
+{
+    const unsigned int features = 6;
+    const unsigned int units = 8;
+    const std::size_t steps = 10;
+    const std::size_t interval = 4;
+
+    // Single LSTM layer model with random weights:
+    std::unique_ptr<pt::Model> lstmModel(bool returnSequences, unsigned int seed)
+    {
+        std::mt19937 random(seed);
+        std::ostringstream stream;
+
+        writeModelHeader(stream, 1);
+        writeLstm(stream, units, features, returnSequences, random);
+
+        std::istringstream inStream(stream.str());
+        return pt::Model::create(inStream);
+    }
+
+    // Sequence which shares its first prefixSteps with the base sequence:
+    pt::Tensor sequence(unsigned int seed, std::size_t prefixSteps)
+    {
+        std::mt19937 baseRandom(1234);
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> distribution(-1, 1);
+        pt::Tensor in(steps, features);
+        auto prefixEnd = in.begin() + long(prefixSteps * features);
+
+        for(auto it = in.begin(), end = in.end(); it != end; ++it)
+        {
+            auto baseValue = distribution(baseRandom);
+            auto value = distribution(random);
+            *it = pt::Tensor::Type(it < prefixEnd ? baseValue : value);
+        }
+
+        return in;
+    }
+
+    pt::Tensor predict(pt::Model& model, const std::shared_ptr<pt::LstmPrefixCache>& cache,
+                       const pt::Tensor& in)
+    {
+        pt::Dispatcher dispatcher;
+        model.getConfig().setLstmPrefixCache(cache);
+
+        pt::Tensor out;
+        REQUIRE(model.predict(dispatcher, in, out));
+        return out;
+    }
+
+    void testCachedOutput(bool returnSequences)
+    {
+        auto model = lstmModel(returnSequences, 5);
+        REQUIRE(model);
+
+        auto cache = std::make_shared<pt::LstmPrefixCache>(1024 * 1024, interval);
+
+        for(std::size_t prefixSteps : { 0, 10, 9, 4, 8, 10, 3, 0 })
+        {
+            auto in = sequence(unsigned(prefixSteps) + 1, prefixSteps);
+            auto out = predict(*model, nullptr, in);
+            auto cachedOut = predict(*model, cache, in);
+            testTensors(cachedOut, out, 1e-5f);
+        }
+
+        REQUIRE(cache->getHits() > 0);
+    }
+}
+
+TEST_CASE("LSTM prefix cache sequences output test")
+{
+    testCachedOutput(true);
+}
+
+TEST_CASE("LSTM prefix cache last output test")
+{
+    testCachedOutput(false);
+}
+
+TEST_CASE("LSTM prefix cache counters test")
+{
+    auto model = lstmModel(false, 5);
+    REQUIRE(model);
+
+    auto cache = std::make_shared<pt::LstmPrefixCache>(1024 * 1024, interval);
+    auto in = sequence(1, steps);
+
+    predict(*model, cache, in);
+    REQUIRE(cache->getHits() == 0);
+    REQUIRE(cache->getMisses() == 1);
+    REQUIRE(cache->getEntriesCount() == steps / interval);
+
+    predict(*model, cache, in);
+    REQUIRE(cache->getHits() == 1);
+    REQUIRE(cache->getMisses() == 1);
+    REQUIRE(cache->getSkippedSteps() == steps / interval * interval);
+
+    // Only the first checkpoint is shared:
+    predict(*model, cache, sequence(2, interval + 1));
+    REQUIRE(cache->getHits() == 2);
+    REQUIRE(cache->getSkippedSteps() == steps / interval * interval + interval);
+
+    cache->clear();
+    REQUIRE(cache->getEntriesCount() == 0);
+    REQUIRE(cache->getBytes() == 0);
+    REQUIRE(cache->getHits() == 0);
+    REQUIRE(cache->getMisses() == 0);
+}
+
+TEST_CASE("LSTM prefix cache LRU eviction test")
+{
+    auto model = lstmModel(false, 5);
+    REQUIRE(model);
+
+    auto a = sequence(1, 0);
+    auto b = sequence(2, 0);
+    auto c = sequence(3, 0);
+
+    // Room for three checkpoints:
+    auto entryBytesCache = std::make_shared<pt::LstmPrefixCache>(1024 * 1024, interval);
+    predict(*model, entryBytesCache, a);
+
+    auto entryBytes = entryBytesCache->getBytes() / entryBytesCache->getEntriesCount();
+    auto cache = std::make_shared<pt::LstmPrefixCache>(entryBytes * 3, interval);
+
+    // a1, a2 and b1 fit; b2 evicts a1:
+    predict(*model, cache, a);
+    predict(*model, cache, b);
+    REQUIRE(cache->getEntriesCount() == 3);
+    REQUIRE(cache->getBytes() <= cache->getMaxBytes());
+
+    // a2 hit makes it the most recently used entry, so c1 and c2 evict b1 and b2:
+    predict(*model, cache, a);
+    REQUIRE(cache->getHits() == 1);
+
+    predict(*model, cache, c);
+    REQUIRE(cache->getHits() == 1);
+    REQUIRE(cache->getEntriesCount() == 3);
+
+    predict(*model, cache, a);
+    REQUIRE(cache->getHits() == 2);
+
+    predict(*model, cache, b);
+    REQUIRE(cache->getHits() == 2);
+    REQUIRE(cache->getBytes() <= cache->getMaxBytes());
+}
+
+TEST_CASE("LSTM prefix cache destroyed model test")
+{
+    auto cache = std::make_shared<pt::LstmPrefixCache>(1024 * 1024, interval);
+    auto in = sequence(1, 0);
+
+    for(unsigned int seed = 1; seed != 5; ++seed)
+    {
+        // A new model may be allocated at the same address, but it must not reuse the destroyed model entries:
+        auto model = lstmModel(true, seed);
+        REQUIRE(model);
+
+        auto out = predict(*model, nullptr, in);
+        auto cachedOut = predict(*model, cache, in);
+        testTensors(cachedOut, out, 1e-5f);
+        REQUIRE(cache->getHits() == 0);
+        REQUIRE(cache->getMisses() == seed);
+    }
+}
@@ -0,0 +1,170 @@
+#include "test_util.h"
+
+#include <random>
+#include <vector>
+#include <sstream>
+#include "pt_model.h"
+#include "pt_rnn_state.h"
+
+namespace
+{
+    const unsigned int features = 5;
+    const unsigned int units = 8;
+    const std::size_t steps = 10;
+    const std::size_t maskedStep = 6;
+
+    // Masking and LSTM layers model with random weights:
+    std::unique_ptr<pt::Model> lstmModel(unsigned int lstmUnits, bool returnSequences)
+    {
+        std::mt19937 random(lstmUnits);
+        std::ostringstream stream;
+
+        writeModelHeader(stream, 2);
+        writeValue(stream, 17u); // Masking layer
+        writeValue(stream, 0.0f); // Mask value
+        writeLstm(stream, lstmUnits, features, returnSequences, random);
+
+        std::istringstream inStream(stream.str());
+        return pt::Model::create(inStream);
+    }
+
+    // Random sequence with a masked step:
+    pt::Tensor sequence()
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> distribution(-1, 1);
+        pt::Tensor in(steps, features);
+        auto maskedBegin = in.begin() + long(maskedStep * features);
+        auto maskedEnd = maskedBegin + features;
+
+        for(auto it = in.begin(), end = in.end(); it != end; ++it)
+        {
+            *it = it >= maskedBegin && it < maskedEnd ? 0 : pt::Tensor::Type(distribution(random));
+        }
+
+        return in;
+    }
+
+    pt::Tensor chunk(const pt::Tensor& in, std::size_t firstStep, std::size_t chunkSteps)
+    {
+        auto chunkBegin = in.begin() + long(firstStep * features);
+        pt::Tensor out(chunkSteps, features);
+        std::copy(chunkBegin, chunkBegin + long(chunkSteps * features), out.begin());
+        return out;
+    }
+
+    // Steps the model chunk by chunk (single steps are given as 1D tensors) and compares the outputs with predict:
+    void testSteps(bool returnSequences, const std::vector<std::size_t>& chunksSteps)
+    {
+        auto model = lstmModel(units, returnSequences);
+        REQUIRE(model);
+
+        auto in = sequence();
+        pt::Tensor expected;
+        REQUIRE(model->predict(in, expected));
+
+        pt::RnnState state;
+        REQUIRE(state.isEmpty());
+
+        std::vector<pt::Tensor::Type> outputs;
+        pt::Tensor out;
+        std::size_t firstStep = 0;
+
+        for(auto chunkSteps : chunksSteps)
+        {
+            auto stepIn = chunk(in, firstStep, chunkSteps);
+
+            if(chunkSteps == 1)
+            {
+                stepIn.flatten();
+            }
+
+            REQUIRE(model->step(state, std::move(stepIn), out));
+            REQUIRE(! state.isEmpty());
+            outputs.insert(outputs.end(), out.begin(), out.end());
+            firstStep += chunkSteps;
+        }
+
+        REQUIRE(firstStep == steps);
+
+        if(returnSequences)
+        {
+            out.resize(steps, units);
+            REQUIRE(outputs.size() == out.getSize());
+            std::copy(outputs.begin(), outputs.end(), out.begin());
+        }
+
+        testTensors(out, expected, 1e-5f);
+    }
+}
+
+TEST_CASE("Model step sequences test")
+{
+    testSteps(true, std::vector<std::size_t>(steps, 1));
+    testSteps(true, { 3, 4, 3 });
+    testSteps(true, { 6, 1, 3 });
+}
+
+TEST_CASE("Model step last output test")
+{
+    testSteps(false, std::vector<std::size_t>(steps, 1));
+    testSteps(false, { 3, 4, 3 });
+    testSteps(false, { 7, 3 });
+}
+
+TEST_CASE("Model step reset test")
+{
+    auto model = lstmModel(units, false);
+    REQUIRE(model);
+
+    auto in = sequence();
+    pt::Tensor expected;
+    REQUIRE(model->predict(in, expected));
+
+    pt::RnnState state;
+    pt::Tensor out;
+    REQUIRE(model->step(state, chunk(in, 0, 4), out));
+    REQUIRE(! state.isEmpty());
+
+    state.reset();
+    REQUIRE(state.isEmpty());
+
+    REQUIRE(model->step(state, in, out));
+    testTensors(out, expected, 1e-5f);
+}
+
+TEST_CASE("Model step invalid state test")
+{
+    auto model = lstmModel(units, false);
+    REQUIRE(model);
+
+    // Same layers and shapes, but a different model:
+    auto otherModel = lstmModel(units, false);
+    REQUIRE(otherModel);
+
+    auto in = sequence();
+    pt::RnnState state;
+    pt::Tensor out;
+    REQUIRE(model->step(state, chunk(in, 0, 4), out));
+    REQUIRE(! otherModel->step(state, chunk(in, 4, 4), out));
+
+    // The state is still valid for its own model:
+    REQUIRE(model->step(state, chunk(in, 4, 4), out));
+
+    // Reset releases the binding:
+    state.reset();
+    REQUIRE(otherModel->step(state, chunk(in, 0, 4), out));
+    REQUIRE(! model->step(state, chunk(in, 4, 4), out));
+}
+
+TEST_CASE("Model unversioned format test")
+{
+    // Models exported by an older pt.py start with the layers count:
+    std::mt19937 random(units);
+    std::ostringstream stream;
+    writeValue(stream, 1u); // Layers count
+    writeLstm(stream, units, features, false, random);
+
+    std::istringstream inStream(stream.str());
+    REQUIRE(! pt::Model::create(inStream));
+}
@@ -0,0 +1,77 @@
+#include "test_util.h"
+
+#include <random>
+#include "pt_dispatcher.h"
+
+namespace
+{
+    pt::Tensor randomTensor(pt::Tensor tensor, unsigned int seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> distribution(-1, 1);
+
+        for(auto& value : tensor)
+        {
+            value = pt::Tensor::Type(distribution(random));
+        }
+
+        return tensor;
+    }
+
+    // Compares add, multiply and fma with a scalar loop which repeats the operands for each leading index:
+    void testBroadcast(const pt::Tensor& inShape, const pt::Tensor& operandShape)
+    {
+        pt::Dispatcher dispatcher;
+        auto in = randomTensor(inShape, 1);
+        auto scale = randomTensor(operandShape, 2);
+        auto bias = randomTensor(operandShape, 3);
+
+        pt::Tensor expectedAdd = in;
+        pt::Tensor expectedMultiply = in;
+        pt::Tensor expectedFma = in;
+        auto operandSize = scale.getSize();
+
+        for(std::size_t i = 0, l = in.getSize(); i != l; ++i)
+        {
+            auto value = in.getData()[i];
+            auto scaleValue = scale.getData()[i % operandSize];
+            auto biasValue = bias.getData()[i % operandSize];
+            *(expectedAdd.begin() + long(i)) = value + scaleValue;
+            *(expectedMultiply.begin() + long(i)) = value * scaleValue;
+            *(expectedFma.begin() + long(i)) = value * scaleValue + biasValue;
+        }
+
+        testTensors(in.add(scale, dispatcher), expectedAdd, 0);
+        testTensors(in.multiply(scale, dispatcher), expectedMultiply, 0);
+        testTensors(in.fma(scale, bias, dispatcher), expectedFma, 1e-6f);
+    }
+}
+
+TEST_CASE("Tensor broadcast bias row test")
+{
+    testBroadcast(pt::Tensor(5, 16), pt::Tensor(16));
+    testBroadcast(pt::Tensor(5, 19), pt::Tensor(19));
+    testBroadcast(pt::Tensor(300, 37), pt::Tensor(37));
+}
+
+TEST_CASE("Tensor broadcast per-channel scale test")
+{
+    testBroadcast(pt::Tensor(2, 3, 32), pt::Tensor(32));
+    testBroadcast(pt::Tensor(3, 7, 13), pt::Tensor(13));
+    testBroadcast(pt::Tensor(40, 40, 3), pt::Tensor(3));
+}
+
+TEST_CASE("Tensor broadcast leading 1 dims test")
+{
+    testBroadcast(pt::Tensor(5, 19), pt::Tensor(1, 19));
+    testBroadcast(pt::Tensor(3, 7, 13), pt::Tensor(1, 1, 13));
+    testBroadcast(pt::Tensor(2, 7, 13), pt::Tensor(1, 7, 13));
+    testBroadcast(pt::Tensor(4, 6, 9, 3), pt::Tensor(1, 1, 9, 3));
+}
+
+TEST_CASE("Tensor broadcast same dims test")
+{
+    testBroadcast(pt::Tensor(37), pt::Tensor(37));
+    testBroadcast(pt::Tensor(3, 5), pt::Tensor(3, 5));
+    testBroadcast(pt::Tensor(96, 97), pt::Tensor(96, 97));
+}
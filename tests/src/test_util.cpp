@@ -1,5 +1,6 @@
 #include "test_util.h"
 
+#include <cmath>
 #include <chrono>
 #include <iostream>
 #include "pt_model.h"
@@ -35,3 +36,97 @@ void testModel(pt::Tensor& in, const pt::Tensor& expected, const char* modelFile
     auto elapsedMcs = std::chrono::duration_cast<std::chrono::microseconds>(elapsedTime).count();
     std::cout << modelFileName << " elapsed mcs: " << elapsedMcs << std::endl;
 }
+
+void testTensors(const pt::Tensor& out, const pt::Tensor& expected, float eps)
+{
+    REQUIRE(out.getDims() == expected.getDims());
+
+    for(std::size_t i = 0, l = out.getSize(); i != l; ++i)
+    {
+        auto diff = std::fabs(out.getData()[i] - expected.getData()[i]);
+
+        if(diff > pt::FloatType(eps))
+        {
+            std::cout << "Diff: " << diff << std::endl;
+            REQUIRE(diff <= pt::FloatType(eps));
+        }
+    }
+}
+
+void writeValue(std::ostream& stream, unsigned int value)
+{
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeValue(std::ostream& stream, float value)
+{
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void writeModelHeader(std::ostream& stream, unsigned int layersCount)
+{
+    writeValue(stream, 0x4d4f5450u); // Magic number
+    writeValue(stream, 2u); // Format version
+    writeValue(stream, layersCount);
+}
+
+void writeConv2D(std::ostream& stream, unsigned int filters, unsigned int kernelSize, unsigned int channels,
+                 unsigned int stride, bool samePadding, unsigned int activation, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+
+    writeValue(stream, 3u); // Conv2D layer
+
+    writeValue(stream, filters);
+    writeValue(stream, kernelSize);
+    writeValue(stream, kernelSize);
+    writeValue(stream, channels);
+
+    for(unsigned int i = 0; i != filters * kernelSize * kernelSize * channels; ++i)
+    {
+        writeValue(stream, distribution(random));
+    }
+
+    writeValue(stream, filters);
+
+    for(unsigned int i = 0; i != filters; ++i)
+    {
+        writeValue(stream, distribution(random));
+    }
+
+    writeValue(stream, activation);
+    writeValue(stream, stride);
+    writeValue(stream, stride);
+    writeValue(stream, samePadding ? 1u : 0u);
+    writeValue(stream, 1u); // Dilation Y
+    writeValue(stream, 1u); // Dilation X
+}
+
+void writeLstm(std::ostream& stream, unsigned int units, unsigned int features, bool returnSequences,
+               std::mt19937& random)
+{
+    std::uniform_real_distribution<float> distribution(-0.5f, 0.5f);
+
+    writeValue(stream, 10u); // LSTM layer
+
+    // W (units, features), U (units, units) and b (1, units) tensors of the i, f, c and o gates:
+    const unsigned int tensorsDims[3][2] = { { units, features }, { units, units }, { 1, units } };
+
+    for(unsigned int gate = 0; gate != 4; ++gate)
+    {
+        for(const auto& dims : tensorsDims)
+        {
+            writeValue(stream, dims[0]);
+            writeValue(stream, dims[1]);
+
+            for(unsigned int i = 0; i != dims[0] * dims[1]; ++i)
+            {
+                writeValue(stream, distribution(random));
+            }
+        }
+    }
+
+    writeValue(stream, 6u); // Sigmoid inner activation
+    writeValue(stream, 7u); // Tanh activation
+    writeValue(stream, returnSequences ? 1u : 0u);
+}
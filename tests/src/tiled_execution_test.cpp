@@ -0,0 +1,71 @@
+#include "test_util.h"
+
+#include <random>
+#include <sstream>
+#include "pt_model.h"
+#include "pt_dispatcher.h"
+
+namespace
+{
+    // Conv2D, strided Conv2D, overlapping MaxPooling2D, Conv2D and Activation layers model with random weights:
+    std::string convStackModel(std::mt19937& random)
+    {
+        std::ostringstream stream;
+
+        writeModelHeader(stream, 6);
+        writeConv2D(stream, 8, 3, 3, 1, true, 2, random);
+        writeConv2D(stream, 16, 3, 8, 2, false, 2, random);
+
+        writeValue(stream, 9u); // MaxPooling2D layer
+        writeValue(stream, 3u); // Pool size Y
+        writeValue(stream, 3u); // Pool size X
+        writeValue(stream, 2u); // Stride Y
+        writeValue(stream, 2u); // Stride X
+        writeValue(stream, 1u); // Same padding
+
+        writeConv2D(stream, 16, 5, 16, 1, true, 2, random);
+        writeConv2D(stream, 8, 1, 16, 1, false, 2, random);
+
+        writeValue(stream, 8u); // Activation layer
+        writeValue(stream, 7u); // Tanh activation
+        return stream.str();
+    }
+
+    void testTiledExecution(std::size_t tileSize, std::size_t rows, std::size_t cols)
+    {
+        std::mt19937 random(unsigned(tileSize * rows + cols));
+        std::istringstream stream(convStackModel(random));
+        auto model = pt::Model::create(stream);
+        REQUIRE(model);
+
+        pt::Tensor in(rows, cols, 3);
+        std::uniform_real_distribution<float> distribution(0, 1);
+
+        for(auto& value : in)
+        {
+            value = pt::Tensor::Type(distribution(random));
+        }
+
+        pt::Dispatcher dispatcher;
+        pt::Tensor tiledIn = in;
+        pt::Tensor tiledOut;
+        model->getConfig().setTileSize(tileSize);
+        REQUIRE(model->predict(dispatcher, tiledIn, tiledOut));
+
+        pt::Tensor out;
+        model->getConfig().setTileSize(0);
+        REQUIRE(model->predict(dispatcher, in, out));
+
+        testTensors(tiledOut, out, 1e-5f);
+    }
+}
+
+TEST_CASE("tiled_execution_small_tiles")
+{
+    testTiledExecution(3, 31, 27);
+}
+
+TEST_CASE("tiled_execution_large_tiles")
+{
+    testTiledExecution(16, 45, 38);
+}